@@ -1,48 +1,133 @@
 import {PrivateKey} from "bitsharesjs"
 import {BitShares} from "../api/bitshares";
 import {Crypto} from "../utils/crypto";
-import {Settings} from "../settings";
+import {Monitor} from "../utils/monitor";
+import {Deadline} from "../utils/deadline";
+import {Priority} from "../api/scheduler";
+import {authoritiesFor} from "./authorities";
+import {keyBytes} from "./records";
+import {HistoryStream} from "./history";
+import {balancesFor} from "./balances";
+import {findAccountsByKeys} from "./references";
 
 require('isomorphic-fetch');
 
+const addressPrefix = (client) => {
+  let chain = client.chain();
+  return (chain && chain.address_prefix) || "BTS";
+};
+
+const verify = (name, password, activePrivate, matches, memoIsActive) => Monitor.track("LoginVerify", () => {
+  if (!matches) {
+    throw new Error("The pair of login and password do not match!")
+  }
+
+  let memoKey = PrivateKey.fromWif((memoIsActive ? activePrivate : PrivateKey.fromSeed(`${name}memo${password}`)).toWif());
+  return {memoKey: memoKey}
+});
+
+// Resolves true if the record still holds, false if the keys rotated or the account is gone, and
+// null if the node could not be asked.
+const revalidate = (client, cache, previous, onKeyRotation) => {
+  let name = previous.name;
+  let pending = cache.revalidating.get(name);
+  if (pending) return pending;
+
+  pending = client.api().DB.AccountByName(name, {priority: Priority.BACKGROUND}).then(acc => {
+    let current = acc && acc.name === name ? cache.set(acc) : null;
+    if (!current) cache.delete(name);
+    let valid = current !== null && current.sameKeys(previous);
+    if (!valid) {
+      client.metricsRegistry.count("login.rotated");
+      if (onKeyRotation) onKeyRotation(name, previous, current);
+    }
+    return valid;
+  }, () => {
+    client.metricsRegistry.count("login.revalidate.error");
+    return null;
+  }).finally(() => cache.revalidating.delete(name));
+
+  cache.revalidating.set(name, pending);
+  return pending;
+};
+
 export const Account = {
-  getAccount: async (name) => {
+  getAccount: async (name, {client = BitShares, signal = null, timeout = null} = {}) => Deadline.run({signal, timeout}, async deadline => {
 
     console.log("Get by name Name", name)
-    let acc = await BitShares.api().DB.AccountByName(name).catch(err => console.log(err));
+    let acc = await client.api().DB.AccountByName(name, {signal: deadline, priority: Priority.INTERACTIVE}).catch(err => console.log(err));
+    Deadline.check(deadline);
     if (!acc || acc.name !== name) {
       throw new Error(`Not found account ${name}! Blockchain return ${acc ? acc.name : acc}`);
     }
     return acc;
-  },
+  }),
 
-  login: async (name, password) => {
-    let acc = await BitShares.api().DB.AccountByName(name).catch(err => console.log(err));
-    let {privKey: activePrivate, pubKey: activePub} = Crypto.KeyFromPassword(name, "active", password);
+  // With `cached` a repeat login is verified against the account record of the previous one and
+  // returns at once. The account is then fetched in the background; `revalidated` resolves false and
+  // `onKeyRotation(name, previous, current)` fires with both records when an owner, active or memo
+  // key changed since.
+  login: async (name, password, {
+    client = BitShares, cached = false, authorities = null, onKeyRotation = null, signal = null, timeout = null
+  } = {}) => Deadline.run({signal, timeout}, async deadline => {
+    let cache = authorities || authoritiesFor(client);
+    let record = cached ? cache.get(name) : null;
+    let pending = record ? null : client.api().DB.AccountByName(name, {signal: deadline, priority: Priority.INTERACTIVE}).catch(err => console.log(err));
+    Deadline.check(deadline);
+    let {privKey: activePrivate, pubKey: activePub} = Crypto.KeyFromPassword(name, "active", password, addressPrefix(client));
 
-    if (activePub !== acc.active.key_auths[0][0]) {
-      throw new Error("The pair of login and password do not match!")
+    let activeKey = record ? record.key("active") : -1;
+    if (activeKey !== -1 && activeKey === cache.keys.find(keyBytes(activePub))) {
+      client.metricsRegistry.count("login.cached");
+      let res = verify(name, password, activePrivate, true, record.memo === activeKey);
+      res.revalidated = revalidate(client, cache, record, onKeyRotation);
+      return res;
     }
 
-    let memoKey = PrivateKey.fromWif((acc.options.memo_key === activePub ? activePrivate : PrivateKey.fromSeed(`${name}memo${password}`)).toWif());
-    return {memoKey: memoKey}
-  },
+    let acc = await (pending || client.api().DB.AccountByName(name, {signal: deadline, priority: Priority.INTERACTIVE}).catch(err => console.log(err)));
+    Deadline.check(deadline);
+    let res = verify(name, password, activePrivate, acc.active.key_auths[0][0] === activePub, acc.options.memo_key === activePub);
+    if (cached) cache.set(acc);
+    return res;
+  }),
+
+  // Async iterator over the operations of an account name or 1.2.x id, newest first:
+  // `for await (let op of Account.history("alice")) ...`. See HistoryStream for the options.
+  history: (name, options = {}) => new HistoryStream(options.client || BitShares, name, options),
+
+  // Balances of account names or 1.2.x ids as fixed-point strings, optionally only of the given
+  // asset symbols or ids. See BalanceBook.get for the result shape.
+  getBalances: async (accounts, assets = null, {client = BitShares, signal = null, timeout = null, priority} = {}) =>
+    Deadline.run({signal, timeout}, deadline => balancesFor(client).get([].concat(accounts), assets, {signal: deadline, priority})),
+
+  // [{key, accounts}] for public key strings or Crypto.KeyFromPassword results, e.g. to find the
+  // accounts a password controls: Account.findAccountsByKeys(["owner", "active"].map(role =>
+  // Crypto.KeyFromPassword(name, role, password))).
+  findAccountsByKeys: async (keys, {client = BitShares, signal = null, timeout = null, priority} = {}) =>
+    Deadline.run({signal, timeout}, deadline => findAccountsByKeys(client, [].concat(keys), {signal: deadline, priority})),
 
-  create: async (name, password) => {
+  create: async (name, password, {client = BitShares, signal = null, timeout = null} = {}) => Deadline.run({signal, timeout}, async deadline => {
     console.log("create account", name, password);
-    let {pubKey: ownerPub} = Crypto.KeyFromPassword(name, "owner", password);
-    let {pubKey: activePub} = Crypto.KeyFromPassword(name, "active", password);
-    let {pubKey: memoPub} = Crypto.KeyFromPassword(name, "memo", password);
+    let prefix = addressPrefix(client);
+    let derive = (role) => {
+      Deadline.check(deadline);
+      return Crypto.KeyFromPassword(name, role, password, prefix);
+    };
+    let {pubKey: ownerPub} = derive("owner");
+    let {pubKey: activePub} = derive("active");
+    let {pubKey: memoPub} = derive("memo");
     console.log("owner", ownerPub);
     console.log("active", activePub);
     console.log("memo", memoPub);
 
-    let faucetAddress = Settings.DefaultFaucet;
-    return await fetch(
+    let faucetAddress = client.faucet;
+    Deadline.check(deadline);
+    return await Deadline.race(fetch(
       faucetAddress + "/api/v1/accounts",
       {
         method: "post",
         mode: "cors",
+        signal: deadline || undefined,
         headers: {
           Accept: "application/json",
           "Content-type": "application/json",
@@ -58,8 +143,8 @@ export const Account = {
           },
         }),
       },
-    ).then(r => r.json());
-  },
+    ).then(r => r.text()), deadline).then(text => Monitor.track("JSONDecode", () => JSON.parse(text)));
+  }),
 };
 
 /*
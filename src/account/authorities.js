@@ -0,0 +1,94 @@
+import fs from "fs";
+import {compactKeys, dumpRecords, KeyTable, loadRecords, projectAccount} from "./records";
+import {LruCache} from "../utils/cache";
+
+const FILE_VERSION = 2;
+const COMPACT_MIN = 1024;
+
+/**
+ * Authorities and memo keys of accounts seen at login as compact AccountRecords sharing one
+ * KeyTable, held in memory within `budget` bytes and optionally mirrored to a JSON file so repeat
+ * logins survive restarts. Keys of evicted records stay interned until the table has doubled since
+ * its last compaction, then only the keys of cached records are kept.
+ */
+export class AuthorityCache {
+  constructor({path = null, saveDelay = 1000, budget = 64 * 1024 * 1024} = {}) {
+    this.path = path;
+    this.saveDelay = saveDelay;
+    this.keys = new KeyTable();
+    this.compactAt = COMPACT_MIN;
+    this.accounts = new LruCache({name: "authorities", budget});
+    this.revalidating = new Map();
+    this.saveTimer = null;
+  }
+
+  get(name) {
+    return this.accounts.get(name) || null;
+  }
+
+  // Stores the projection of a get_account_by_name result.
+  set(acc) {
+    this.compact();
+    let record = projectAccount(acc, this.keys);
+    this.accounts.set(record.name, record);
+    this.scheduleSave();
+    return record;
+  }
+
+  delete(name) {
+    this.accounts.delete(name);
+    this.scheduleSave();
+  }
+
+  // Skipped while a revalidation runs: the record it compares against may have left the cache and
+  // would keep indexes of the old table.
+  compact() {
+    if (this.keys.count < this.compactAt || this.revalidating.size) return;
+    this.keys = compactKeys(Array.from(this.accounts.values()), this.keys);
+    this.compactAt = Math.max(COMPACT_MIN, 2 * this.keys.count);
+  }
+
+  scheduleSave() {
+    if (!this.path || this.saveTimer) return;
+    this.saveTimer = setTimeout(() => {
+      this.saveTimer = null;
+      this.save().catch(() => null);
+    }, this.saveDelay);
+    if (this.saveTimer.unref) this.saveTimer.unref();
+  }
+
+  async save() {
+    if (!this.path) return;
+    let data = JSON.stringify(Object.assign({version: FILE_VERSION}, dumpRecords(Array.from(this.accounts.values()), this.keys)));
+    await fs.promises.writeFile(`${this.path}.tmp`, data);
+    await fs.promises.rename(`${this.path}.tmp`, this.path);
+  }
+
+  async load() {
+    if (!this.path) return 0;
+    let data;
+    try {
+      data = JSON.parse(await fs.promises.readFile(this.path, "utf8"));
+    } catch (e) {
+      if (e.code === "ENOENT") return 0;
+      throw e;
+    }
+    if (data.version !== FILE_VERSION) return 0;
+    this.compact();
+    let records = loadRecords(data, this.keys);
+    records.forEach(record => this.accounts.set(record.name, record));
+    return records.length;
+  }
+}
+
+const caches = new WeakMap();
+
+// Default cache of a client, created on first use.
+export const authoritiesFor = (client) => {
+  let cache = caches.get(client);
+  if (!cache) {
+    cache = new AuthorityCache();
+    caches.set(client, cache);
+  }
+  return cache;
+};
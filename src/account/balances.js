@@ -0,0 +1,127 @@
+import {Deadline} from "../utils/deadline";
+import {LruCache} from "../utils/cache";
+import {Priority} from "../api/scheduler";
+
+const isAccountId = (key) => /^1\.2\.\d+$/.test(key);
+
+/**
+ * Integer satoshi amount as a decimal string with `precision` fraction digits, e.g. 1234500 at
+ * precision 5 is "12.34500". Works on the digits so int64 amounts the node sends as strings stay exact.
+ */
+export const formatAmount = (amount, precision) => {
+  let digits = String(amount);
+  let sign = "";
+  if (digits[0] === "-") {
+    sign = "-";
+    digits = digits.slice(1);
+  }
+  if (!precision) return sign + digits;
+  while (digits.length <= precision) digits = `0${digits}`;
+  return `${sign}${digits.slice(0, -precision)}.${digits.slice(-precision)}`;
+};
+
+/**
+ * Balances of many accounts for one client. Account names are resolved with get_account_by_name,
+ * once per name, and 1.2.x ids through the object store; an account neither knows has no balances.
+ * get_account_balances then runs once per distinct account, spread by the client over its pool.
+ * Results are cached per account and asset filter and stay valid while the head block reported by
+ * the object store does not move.
+ */
+export class BalanceBook {
+  constructor(client, {budget = 8 * 1024 * 1024} = {}) {
+    this.client = client;
+    this.cache = new LruCache({name: "balances", budget});
+    this.ids = new LruCache({name: "balances.accounts", budget: budget / 8});
+    this.inflight = new Map();
+  }
+
+  // For every account in order, [{asset_id, symbol, precision, amount, value}] with `amount` the raw
+  // integer string and `value` the fixed-point string, or null for an unknown account. `assets` are
+  // symbols or 1.3.x ids to restrict the balances to; all balances without it.
+  async get(accounts, assets = null, {signal = null, priority = Priority.DEFAULT} = {}) {
+    Deadline.check(signal);
+    let assetIds = [];
+    if (assets && assets.length) {
+      let resolved = await this.client.assets.resolve(assets, {signal, priority});
+      resolved.forEach((asset, i) => {
+        if (!asset) throw new Error(`Unknown asset ${assets[i]}`);
+        assetIds.push(asset.id);
+      });
+      assetIds.sort();
+    }
+    let props = await this.client.objects.get("2.1.0", {signal, priority});
+    let block = props.head_block_number;
+    let filter = assetIds.join(",");
+
+    let results = new Map();
+    await Deadline.race(Promise.all(Array.from(new Set(accounts)).map(account =>
+      this.fetch(account, assetIds, filter, block, priority).then(balances => results.set(account, balances))
+    )), signal);
+    let raw = accounts.map(account => results.get(account));
+
+    let ids = new Set();
+    raw.forEach(balances => balances && balances.forEach(b => ids.add(b.asset_id)));
+    let list = Array.from(ids);
+    let infos = await this.client.assets.resolve(list, {signal, priority});
+    let byId = new Map(list.map((id, i) => [id, infos[i]]));
+    return raw.map(balances => balances && balances.map(b => {
+      let asset = byId.get(b.asset_id);
+      if (!asset) throw new Error(`Unknown asset ${b.asset_id}`);
+      return {
+        asset_id: b.asset_id,
+        symbol: asset.symbol,
+        precision: asset.precision,
+        amount: String(b.amount),
+        value: formatAmount(b.amount, asset.precision),
+      };
+    }));
+  }
+
+  fetch(account, assetIds, filter, block, priority) {
+    let key = `${account}|${filter}`;
+    let entry = this.cache.get(key);
+    if (entry && entry.block === block) return Promise.resolve(entry.balances);
+    let pending = this.inflight.get(key);
+    if (pending && pending.block === block) return pending.promise;
+
+    let promise = this.accountId(account, priority).then(id => {
+      if (!id) return null;
+      return this.client.exec("get_account_balances", [id, assetIds], {priority}).then(balances => {
+        this.cache.set(key, {block, balances});
+        return balances;
+      });
+    }).finally(() => {
+      if (this.inflight.get(key) === pending) this.inflight.delete(key);
+    });
+    pending = {block, promise};
+    this.inflight.set(key, pending);
+    return promise;
+  }
+
+  // 1.2.x id of an account name or id, null for an account that does not exist. Ids of names are
+  // kept, names are never reassigned; misses are not, the account may be registered later.
+  async accountId(account, priority) {
+    if (isAccountId(account)) {
+      let acc = await this.client.objects.get(account, {priority, type: "account"});
+      return acc ? acc.id : null;
+    }
+    let id = this.ids.get(account);
+    if (id) return id;
+    let acc = await this.client.api().DB.AccountByName(account, {priority});
+    if (!acc || acc.name !== account) return null;
+    this.ids.set(account, acc.id);
+    return acc.id;
+  }
+}
+
+const books = new WeakMap();
+
+// Balance book of a client, created on first use.
+export const balancesFor = (client) => {
+  let book = books.get(client);
+  if (!book) {
+    book = new BalanceBook(client);
+    books.set(client, book);
+  }
+  return book;
+};
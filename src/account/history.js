@@ -0,0 +1,140 @@
+import {Deadline} from "../utils/deadline";
+import {Priority} from "../api/scheduler";
+
+const asyncIterator = (typeof Symbol !== "undefined" && Symbol.asyncIterator) || "@@asyncIterator";
+
+const instance = (objectId) => Number(objectId.slice(objectId.lastIndexOf(".") + 1));
+
+const isAccountId = (key) => /^1\.2\.\d+$/.test(key);
+
+/**
+ * Operations of one account, newest first, as an async iterator over pages of the history API.
+ * Up to `prefetch` pages of `pageSize` operations are fetched ahead while the consumer works through
+ * the current one. get_account_history pages by operation id; with `relative` pages are sequence
+ * ranges of get_relative_account_history counted down from the account's total_ops. An aborted
+ * signal or return() stops prefetching and ends the iteration; a failed page is thrown from next().
+ */
+export class HistoryStream {
+  constructor(client, account, {pageSize = 100, prefetch = 2, relative = false, signal = null, priority = Priority.DEFAULT} = {}) {
+    this.client = client;
+    this.account = account;
+    this.pageSize = pageSize;
+    this.prefetch = Math.max(1, prefetch);
+    this.relative = relative;
+    this.signal = signal;
+    this.priority = priority;
+    this.pages = [];
+    this.page = null;
+    this.offset = 0;
+    this.cursor = null;
+    this.exhausted = false;
+    this.stopped = false;
+    this.fetching = null;
+    this.error = null;
+    this.starting = null;
+    this.unlisten = Deadline.listen(signal, () => this.stop());
+  }
+
+  [asyncIterator]() {
+    return this;
+  }
+
+  async next() {
+    for (;;) {
+      Deadline.check(this.signal);
+      if (this.page && this.offset < this.page.length) {
+        return {value: this.page[this.offset++], done: false};
+      }
+      if (this.pages.length) {
+        this.page = this.pages.shift();
+        this.offset = 0;
+        this.fill();
+        continue;
+      }
+      if (this.error) {
+        let error = this.error;
+        this.stop();
+        throw error;
+      }
+      if (this.stopped || (this.exhausted && !this.fetching)) {
+        this.stop();
+        return {value: undefined, done: true};
+      }
+      if (!this.starting) {
+        this.starting = this.start().catch(error => {
+          this.error = error;
+        });
+      }
+      await Deadline.race(this.starting.then(() => this.fetching), this.signal);
+    }
+  }
+
+  // Ends the iteration, pages in flight are dropped.
+  return() {
+    this.stop();
+    return Promise.resolve({value: undefined, done: true});
+  }
+
+  stop() {
+    this.stopped = true;
+    this.pages = [];
+    this.page = null;
+    this.unlisten();
+  }
+
+  async start() {
+    let id = this.account;
+    let acc = null;
+    if (!isAccountId(id) || this.relative) {
+      acc = isAccountId(id) ?
+        await this.client.objects.get(id, {signal: this.signal, priority: this.priority}) :
+        await this.client.api().DB.AccountByName(id, {signal: this.signal, priority: this.priority});
+      if (!acc || (!isAccountId(id) && acc.name !== id)) {
+        throw new Error(`Not found account ${id}!`);
+      }
+      id = acc.id;
+    }
+    this.account = id;
+    if (this.relative) {
+      let stats = await this.client.objects.get(acc.statistics, {signal: this.signal, priority: this.priority});
+      this.cursor = stats.total_ops;
+      if (this.cursor <= 0) this.exhausted = true;
+    } else {
+      this.cursor = 0;
+    }
+    this.fill();
+  }
+
+  fill() {
+    if (this.fetching || this.exhausted || this.stopped || this.error || this.pages.length >= this.prefetch) return;
+    this.fetching = this.fetchPage().then(page => {
+      this.fetching = null;
+      if (this.stopped) return;
+      if (page.length) this.pages.push(page);
+      this.fill();
+    }, error => {
+      this.fetching = null;
+      this.error = error;
+    });
+  }
+
+  fetchPage() {
+    let options = {api: "history", signal: this.signal, priority: this.priority};
+    if (this.relative) {
+      let start = this.cursor;
+      return this.client.exec("get_relative_account_history", [this.account, 0, this.pageSize, start], options).then(page => {
+        this.cursor = start - this.pageSize;
+        if (this.cursor <= 0 || page.length < this.pageSize) this.exhausted = true;
+        return page;
+      });
+    }
+    // 1.11.0 as start means the newest operation, the cursor is the next older id from then on.
+    let start = `1.11.${this.cursor}`;
+    return this.client.exec("get_account_history", [this.account, "1.11.0", this.pageSize, start], options).then(page => {
+      let next = page.length ? instance(page[page.length - 1].id) - 1 : 0;
+      if (next <= 0 || page.length < this.pageSize) this.exhausted = true;
+      this.cursor = next;
+      return page;
+    });
+  }
+}
@@ -0,0 +1,270 @@
+import {hash} from "bitsharesjs";
+
+const KEY_SIZE = 33;
+// A compressed key plus its 4-byte checksum always encodes to 50 base58 digits, the rest of a
+// public key string is the address prefix.
+const KEY_DIGITS = 50;
+const ALPHABET = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+const DIGITS = new Int8Array(128).fill(-1);
+for (let i = 0; i < ALPHABET.length; i++) DIGITS[ALPHABET.charCodeAt(i)] = i;
+
+/**
+ * Compressed key bytes of a public key string. The checksum is not verified: keys come from the
+ * node or from our own derivation. Returns null for anything that is not a public key.
+ */
+export const keyBytes = (pubKey) => {
+  if (typeof pubKey !== "string" || pubKey.length <= KEY_DIGITS) return null;
+  let out = new Uint8Array(KEY_SIZE + 4);
+  for (let i = pubKey.length - KEY_DIGITS; i < pubKey.length; i++) {
+    let c = pubKey.charCodeAt(i);
+    let carry = c < 128 ? DIGITS[c] : -1;
+    if (carry === -1) return null;
+    for (let j = out.length - 1; j >= 0; j--) {
+      carry += out[j] * 58;
+      out[j] = carry & 0xff;
+      carry >>= 8;
+    }
+    if (carry) return null;
+  }
+  return out.subarray(0, KEY_SIZE);
+};
+
+const keyString = (bytes, prefix) => {
+  let checksum = hash.ripemd160(Buffer.from(bytes));
+  let data = new Uint8Array(KEY_SIZE + 4);
+  data.set(bytes);
+  data.set(checksum.subarray(0, 4), KEY_SIZE);
+  let digits = [];
+  for (let i = 0; i < data.length; i++) {
+    let carry = data[i];
+    for (let j = 0; j < digits.length; j++) {
+      carry += digits[j] << 8;
+      digits[j] = carry % 58;
+      carry = (carry / 58) | 0;
+    }
+    while (carry) {
+      digits.push(carry % 58);
+      carry = (carry / 58) | 0;
+    }
+  }
+  let text = prefix;
+  for (let i = digits.length - 1; i >= 0; i--) text += ALPHABET[digits[i]];
+  return text;
+};
+
+const toHex = (bytes) => Buffer.from(bytes).toString("hex");
+
+const fromHex = (hex) => Uint8Array.from(Buffer.from(hex, "hex"));
+
+/**
+ * Interned public keys: every distinct key is stored once as 33 bytes in a slab and accounts refer
+ * to it by index, so equal keys compare as equal indexes. Lookups go through an open-addressed table
+ * hashed on the key's x coordinate bytes. Keys are never removed; compactKeys moves the keys still
+ * in use to a new table.
+ */
+export class KeyTable {
+  constructor(capacity = 1024) {
+    this.count = 0;
+    this.slab = new Uint8Array(capacity * KEY_SIZE);
+    this.table = new Int32Array(capacity * 2).fill(-1);
+  }
+
+  // Index of the key with these bytes, or -1.
+  find(bytes) {
+    if (!bytes) return -1;
+    let mask = this.table.length - 1;
+    let slot = this.hash(bytes) & mask;
+    let index;
+    while ((index = this.table[slot]) !== -1) {
+      if (this.matches(index, bytes)) return index;
+      slot = (slot + 1) & mask;
+    }
+    return -1;
+  }
+
+  // Index of a key string or key bytes, added if new.
+  intern(key) {
+    let bytes = typeof key === "string" ? keyBytes(key) : key;
+    if (!bytes) return -1;
+    let index = this.find(bytes);
+    if (index !== -1) return index;
+
+    if ((this.count + 1) * KEY_SIZE > this.slab.length) {
+      let slab = new Uint8Array(this.slab.length * 2);
+      slab.set(this.slab);
+      this.slab = slab;
+    }
+    index = this.count++;
+    this.slab.set(bytes, index * KEY_SIZE);
+    if (this.count * 2 > this.table.length) this.rehash(this.table.length * 2);
+    else this.place(index);
+    return index;
+  }
+
+  bytes(index) {
+    return this.slab.subarray(index * KEY_SIZE, (index + 1) * KEY_SIZE);
+  }
+
+  toString(index, prefix = "BTS") {
+    return keyString(this.bytes(index), prefix);
+  }
+
+  hash(bytes) {
+    return (bytes[1] | (bytes[2] << 8) | (bytes[3] << 16) | (bytes[4] << 24)) >>> 0;
+  }
+
+  matches(index, bytes) {
+    let offset = index * KEY_SIZE;
+    for (let i = 0; i < KEY_SIZE; i++) {
+      if (this.slab[offset + i] !== bytes[i]) return false;
+    }
+    return true;
+  }
+
+  place(index) {
+    let mask = this.table.length - 1;
+    let slot = this.hash(this.bytes(index)) & mask;
+    while (this.table[slot] !== -1) slot = (slot + 1) & mask;
+    this.table[slot] = index;
+  }
+
+  rehash(size) {
+    this.table = new Int32Array(size).fill(-1);
+    for (let i = 0; i < this.count; i++) this.place(i);
+  }
+}
+
+const instance = (objectId) => Number(objectId.slice(objectId.lastIndexOf(".") + 1));
+
+// Packs an authority as [threshold, keys, key, weight, ..., accounts, account, weight, ...] with
+// keys as KeyTable indexes and accounts as instance numbers of 1.2.x ids.
+const packAuthority = (auth, keys) => {
+  let keyAuths = auth.key_auths || [];
+  let accountAuths = auth.account_auths || [];
+  let packed = new Int32Array(3 + 2 * (keyAuths.length + accountAuths.length));
+  let i = 0;
+  packed[i++] = auth.weight_threshold;
+  packed[i++] = keyAuths.length;
+  keyAuths.forEach(([key, weight]) => {
+    packed[i++] = keys.intern(key);
+    packed[i++] = weight;
+  });
+  packed[i++] = accountAuths.length;
+  accountAuths.forEach(([account, weight]) => {
+    packed[i++] = instance(account);
+    packed[i++] = weight;
+  });
+  return packed;
+};
+
+// Interns the keys `records` use into a new KeyTable and rewrites their indexes in place, so the
+// records stay valid. Records not passed keep indexes of the old table.
+export const compactKeys = (records, keys) => {
+  let fresh = new KeyTable();
+  let remap = (index) => (index === -1 ? -1 : fresh.intern(keys.bytes(index)));
+  records.forEach(record => {
+    [record.owner, record.active].forEach(auth => {
+      for (let i = 0; i < auth[1]; i++) auth[2 + 2 * i] = remap(auth[2 + 2 * i]);
+    });
+    record.memo = remap(record.memo);
+  });
+  return fresh;
+};
+
+/**
+ * The part of an account login needs: id, name, owner and active authorities and memo key, with
+ * every key interned in a KeyTable.
+ */
+export class AccountRecord {
+  constructor(id, name, owner, active, memo, fetched = Date.now()) {
+    this.id = id;
+    this.name = name;
+    this.owner = owner;
+    this.active = active;
+    this.memo = memo;
+    this.fetched = fetched;
+  }
+
+  get objectId() {
+    return `1.2.${this.id}`;
+  }
+
+  // Key index of the n-th key of the owner or active authority, or -1.
+  key(role, n = 0) {
+    let auth = this[role];
+    return n < auth[1] ? auth[2 + 2 * n] : -1;
+  }
+
+  threshold(role) {
+    return this[role][0];
+  }
+
+  // [[keyIndex, weight]] of a role.
+  keyAuths(role) {
+    let auth = this[role];
+    let res = [];
+    for (let i = 0; i < auth[1]; i++) res.push([auth[2 + 2 * i], auth[3 + 2 * i]]);
+    return res;
+  }
+
+  // [["1.2.x", weight]] of a role.
+  accountAuths(role) {
+    let auth = this[role];
+    let at = 2 + 2 * auth[1];
+    let res = [];
+    for (let i = 0; i < auth[at]; i++) res.push([`1.2.${auth[at + 1 + 2 * i]}`, auth[at + 2 + 2 * i]]);
+    return res;
+  }
+
+  // Same authorities and memo key; records must share a KeyTable.
+  sameKeys(other) {
+    let same = (a, b) => a.length === b.length && a.every((v, i) => v === b[i]);
+    return other !== null && same(this.owner, other.owner) && same(this.active, other.active) &&
+      this.memo === other.memo;
+  }
+}
+
+/**
+ * Projects a get_account_by_name result to an AccountRecord at ingest, the rest of the object is
+ * dropped.
+ */
+export const projectAccount = (acc, keys) => new AccountRecord(
+  instance(acc.id),
+  acc.name,
+  packAuthority(acc.owner, keys),
+  packAuthority(acc.active, keys),
+  keys.intern(acc.options.memo_key),
+);
+
+// Serialized form of records and the keys they use, with key indexes local to the dump.
+export const dumpRecords = (records, keys) => {
+  let local = new Map();
+  let hexes = [];
+  let remap = (index) => {
+    if (index === -1) return -1;
+    if (!local.has(index)) {
+      local.set(index, hexes.length);
+      hexes.push(toHex(keys.bytes(index)));
+    }
+    return local.get(index);
+  };
+  let remapAuth = (auth) => {
+    let copy = Array.from(auth);
+    for (let i = 0; i < auth[1]; i++) copy[2 + 2 * i] = remap(auth[2 + 2 * i]);
+    return copy;
+  };
+  let accounts = records.map(r => [r.id, r.name, remapAuth(r.owner), remapAuth(r.active), remap(r.memo), r.fetched]);
+  return {keys: hexes, accounts};
+};
+
+export const loadRecords = ({keys: hexes, accounts}, keys) => {
+  let indexes = hexes.map(hex => keys.intern(fromHex(hex)));
+  let remap = (index) => (index === -1 ? -1 : indexes[index]);
+  let remapAuth = (auth) => {
+    let packed = Int32Array.from(auth);
+    for (let i = 0; i < packed[1]; i++) packed[2 + 2 * i] = remap(packed[2 + 2 * i]);
+    return packed;
+  };
+  return accounts.map(([id, name, owner, active, memo, fetched]) =>
+    new AccountRecord(id, name, remapAuth(owner), remapAuth(active), remap(memo), fetched));
+};
@@ -0,0 +1,51 @@
+import {Deadline} from "../utils/deadline";
+import {Priority} from "../api/scheduler";
+
+// Nodes cap get_key_references at api_limit_get_key_references, 100 by default.
+const CHUNK_SIZE = 100;
+
+// Public key string of a key string, a Crypto.KeyFromPassword result or a PublicKey. Derived keys
+// are encoded again with `prefix`, their pubKey carries whatever prefix they were derived with.
+export const publicKeyString = (key, prefix = "BTS") => {
+  if (typeof key === "string") return key;
+  if (key && key.privKey && typeof key.privKey.toPublicKey === "function") {
+    return key.privKey.toPublicKey().toPublicKeyString(prefix);
+  }
+  if (key && typeof key.toPublicKeyString === "function") return key.toPublicKeyString(prefix);
+  throw new Error(`Not a public key: ${key}`);
+};
+
+/**
+ * Accounts referencing each key in any authority or as memo key, in the order of `keys`. Distinct
+ * keys are looked up with get_key_references in chunks of at most chunkSize and the referenced
+ * accounts are loaded through the client's object store, so accounts shared by several keys or
+ * seen before are fetched once.
+ */
+export const findAccountsByKeys = async (client, keys, {signal = null, priority = Priority.DEFAULT, chunkSize = CHUNK_SIZE} = {}) => {
+  Deadline.check(signal);
+  let chain = client.chain();
+  let prefix = (chain && chain.address_prefix) || "BTS";
+  let strings = keys.map(key => publicKeyString(key, prefix));
+  let distinct = Array.from(new Set(strings));
+
+  let chunks = [];
+  for (let i = 0; i < distinct.length; i += chunkSize) chunks.push(distinct.slice(i, i + chunkSize));
+  let results = await Deadline.race(Promise.all(chunks.map(chunk =>
+    client.exec("get_key_references", [chunk], {signal, priority}))), signal);
+
+  let references = new Map();
+  chunks.forEach((chunk, i) => chunk.forEach((key, j) => {
+    references.set(key, Array.from(new Set(results[i][j] || [])));
+  }));
+
+  let ids = new Set();
+  references.forEach(list => list.forEach(id => ids.add(id)));
+  let idList = Array.from(ids);
+  let accounts = await client.objects.getMany(idList, {signal, priority, type: "account"});
+  let byId = new Map(idList.map((id, i) => [id, accounts[i]]));
+
+  return strings.map(key => ({
+    key,
+    accounts: references.get(key).map(id => byId.get(id)).filter(acc => acc),
+  }));
+};
@@ -0,0 +1,143 @@
+import fs from "fs";
+import {Deadline} from "../utils/deadline";
+import {Priority} from "./scheduler";
+import {LruCache} from "../utils/cache";
+import {getFeaturedMarkets, getMyMarketsBases, getMyMarketsQuotes} from "../branding";
+
+const FILE_VERSION = 1;
+
+const isId = (key) => /^1\.3\.\d+$/.test(key);
+
+const compact = (asset) => ({
+  id: asset.id,
+  symbol: asset.symbol,
+  precision: asset.precision,
+  issuer: asset.issuer,
+});
+
+const defaultSymbols = () => {
+  let symbols = new Set(getMyMarketsBases().concat(getMyMarketsQuotes()));
+  getFeaturedMarkets().forEach(pair => {
+    symbols.add(pair[0]);
+    symbols.add(pair[1]);
+  });
+  return Array.from(symbols);
+};
+
+/**
+ * Asset metadata of one client, cached by 1.3.x id within `budget` bytes with a symbol index kept
+ * in step on eviction. Symbols and ids the node does not know are not cached: they are looked up
+ * again on every call, so an asset created later resolves without clearing the registry.
+ */
+export class AssetRegistry {
+  constructor(client, {chunkSize = 50, budget = 4 * 1024 * 1024} = {}) {
+    this.client = client;
+    this.chunkSize = chunkSize;
+    this.bySymbol = new Map();
+    this.byId = new LruCache({
+      name: "assets",
+      budget,
+      onEvict: (id, asset) => this.bySymbol.delete(asset.symbol),
+    });
+    this.pending = new Map();
+  }
+
+  // Resolves symbols or 1.3.x ids, fetching everything not cached in lookup_asset_symbols calls of
+  // at most chunkSize entries. Lookups already in flight are joined instead of requested again.
+  // Aborting only abandons the wait, the shared lookups still fill the cache. A failed lookup fails
+  // every call waiting for it.
+  async resolve(keys, {signal = null, priority} = {}) {
+    Deadline.check(signal);
+    let missing = [];
+    let waiting = new Set();
+    new Set(keys).forEach(key => {
+      if (this.cached(key)) return;
+      if (this.pending.has(key)) waiting.add(this.pending.get(key));
+      else missing.push(key);
+    });
+
+    let requests = [];
+    for (let i = 0; i < missing.length; i += this.chunkSize) {
+      requests.push(this.fetchChunk(missing.slice(i, i + this.chunkSize), priority));
+    }
+    await Deadline.race(Promise.all(requests.concat(Array.from(waiting))), signal);
+    return keys.map(key => this.cached(key, true) || null);
+  }
+
+  get(key) {
+    return this.cached(key) || null;
+  }
+
+  // Resolves every symbol referenced by the branding market lists.
+  async prewarm(symbols) {
+    return await this.resolve(symbols || defaultSymbols(), {priority: Priority.BACKGROUND});
+  }
+
+  async save(path) {
+    let chain = this.client.chain();
+    let data = JSON.stringify({
+      version: FILE_VERSION,
+      chain_id: chain ? chain.chain_id : null,
+      assets: Array.from(this.byId.values()),
+    });
+    await fs.promises.writeFile(`${path}.tmp`, data);
+    await fs.promises.rename(`${path}.tmp`, path);
+  }
+
+  // Loads a file written by save(). Files of another version or chain are ignored.
+  async load(path) {
+    let data;
+    try {
+      data = JSON.parse(await fs.promises.readFile(path, "utf8"));
+    } catch (e) {
+      if (e.code === "ENOENT") return 0;
+      throw e;
+    }
+    let chain = this.client.chain();
+    if (data.version !== FILE_VERSION || (chain && data.chain_id && data.chain_id !== chain.chain_id)) {
+      return 0;
+    }
+    data.assets.forEach(asset => this.store(asset));
+    return data.assets.length;
+  }
+
+  clear() {
+    this.bySymbol.clear();
+    this.byId.clear();
+  }
+
+  // A peek leaves hit/miss stats and recency alone.
+  cached(key, peek = false) {
+    let id = isId(key) ? key : this.bySymbol.get(key);
+    if (id === undefined) {
+      if (!peek) this.byId.misses++;
+      return undefined;
+    }
+    return peek ? this.byId.peek(id) : this.byId.get(id);
+  }
+
+  store(asset) {
+    this.bySymbol.set(asset.symbol, asset.id);
+    this.byId.set(asset.id, asset);
+    return asset;
+  }
+
+  // Assets of symbols or ids in order, null for unknown ones.
+  lookup(keys, priority) {
+    return this.client.api().DB.AssetsBySymbols(keys, {priority});
+  }
+
+  fetchChunk(keys, priority) {
+    let request = this.lookup(keys, priority).then(assets => {
+      keys.forEach((key, i) => {
+        if (assets[i]) this.store(compact(assets[i]));
+      });
+    });
+    let done = () => keys.forEach(key => {
+      if (this.pending.get(key) === request) this.pending.delete(key);
+    });
+    keys.forEach(key => this.pending.set(key, request));
+    request.then(done, done);
+    return request;
+  }
+}
@@ -1,40 +1,274 @@
-import {Apis} from "bitsharesjs-ws";
 import {Settings} from "../settings";
+import {createMetrics, Metrics} from "../utils/metrics";
+import {Connection} from "./connection";
+import {AssetRegistry} from "./assets";
+import {ObjectStore} from "./objects";
+import {Deadline} from "../utils/deadline";
+import {Priority} from "./scheduler";
+import {RateLimiter} from "./ratelimit";
+import {Breaker, NodeHealth} from "./health";
+import {NodeSelector} from "./selector";
+import {Nodes, normalizeUrl} from "./registry";
 
 
-const conn = {
-  connection: null,
-  chain: null,
-};
+// Every call takes trailing options: {signal, priority}.
+const createDbApi = (client) => {
+  const exec = (method, params, options) => client.exec(method, params, options);
 
-const dbApi = {
-  AccountByName: async (name) => {
-    return await Apis.instance().db_api().exec("get_account_by_name", [name]);
-  },
+  return {
+    AccountByName: async (name, options) => {
+      return await exec("get_account_by_name", [name], options);
+    },
+    AssetsBySymbols: async (symbolsOrIds, options) => {
+      return await exec("lookup_asset_symbols", [symbolsOrIds], options);
+    },
+    Ticker: async (base, quote, options) => {
+      return await exec("get_ticker", [base, quote], options);
+    },
+    Volume24: async (base, quote, options) => {
+      return await exec("get_24_volume", [base, quote], options);
+    },
+    LimitOrders: async (base, quote, limit, options) => {
+      return await exec("get_limit_orders", [base, quote, limit], options);
+    },
+    SubscribeMarket: async (callback, base, quote, options) => {
+      return await exec("subscribe_to_market", [callback, base, quote], options);
+    },
+    // Takes the callback given to SubscribeMarket, ChainWebSocket finds the subscription by it.
+    UnsubscribeMarket: async (callback, base, quote, options) => {
+      return await exec("unsubscribe_from_market", [callback, base, quote], options);
+    },
+  };
 };
 
-const bitsharesApi = {
-  DB: dbApi,
+const majority = (values) => {
+  let counts = new Map();
+  values.forEach(v => counts.set(v, (counts.get(v) || 0) + 1));
+  let best = null;
+  counts.forEach((n, v) => {
+    if (best === null || n > counts.get(best)) best = v;
+  });
+  return best;
 };
 
-export const BitShares = {
-  connect: async (url) => {
-    url = url ? url : Settings.DefaultNode;
-    conn.connection = await Apis.instance(url, true).init_promise;
-    conn.chain = conn.connection[0].network;
-  },
-  api: () => {
-    if (conn.chain == null) {
+/**
+ * A BitShares client with its own connections, caches and metrics. Several clients can be
+ * connected at once, e.g. one per tenant or one per chain.
+ */
+export class BitSharesClient {
+  constructor({
+    url = null, faucet = Settings.DefaultFaucet, timeout = 5000, metrics = null, scheduler = {}, rateLimit = {},
+    health = {}, chainId = null, region = null, poolSize = 1, testnet = false, registry = Nodes, lean = false,
+    transport = null, compression = false
+  } = {}) {
+    this.url = url;
+    this.lean = lean;
+    this.transport = transport;
+    this.compression = compression;
+    this.registry = registry;
+    this.autoSelected = false;
+    this.region = region;
+    this.poolSize = poolSize;
+    this.testnet = testnet;
+    this.scheduler = scheduler;
+    this.rateLimit = rateLimit;
+    this.limiters = new Map();
+    this.healthOptions = health;
+    this.nodes = new Map();
+    this.chainId = chainId;
+    this.candidates = [];
+    this.healthTimer = null;
+    this.faucet = faucet;
+    this.timeout = timeout;
+    this.connections = [];
+    this.metricsRegistry = metrics || createMetrics();
+    this.assets = new AssetRegistry(this);
+    this.objects = new ObjectStore(this);
+    this.bitsharesApi = {
+      DB: createDbApi(this),
+    };
+  }
+
+  // Opens one connection per url, calls are spread over the connections of the pool. Nodes with an
+  // open breaker are skipped and nodes that fail to connect or serve another chain are left out;
+  // connect only fails when no node could be opened. Without a url, or with the automatic-selection
+  // placeholder, poolSize nodes are picked nearest to the region.
+  async connect(url) {
+    let target = url || this.url || Settings.DefaultNode;
+    let auto = target === Settings.DefaultNode;
+    let urls = auto ? await this.selectNodes() : [].concat(target).map(u => normalizeUrl(u) || u);
+    let candidates = urls.filter(u => this.healthOf(u).available());
+    let opened = await this.open(candidates.length ? candidates : urls);
+    if (!opened.length) {
+      throw new Error(`Could not connect to any of ${urls.join(", ")}`);
+    }
+    await this.close();
+    this.autoSelected = auto;
+    this.candidates = urls;
+    this.connections = opened;
+  }
+
+  async selectNodes(count = this.poolSize, exclude = new Set()) {
+    let {region, nodes, failed} = await NodeSelector.select({
+      region: this.region,
+      count: count,
+      timeout: this.timeout,
+      nodes: this.registry.list({testnet: this.testnet}),
+      skip: u => exclude.has(u) || !this.healthOf(u).available(),
+    });
+    failed.forEach(u => this.healthOf(u).trip("probe failed"));
+    if (!nodes.length) {
+      throw new Error("No node answered during automatic selection");
+    }
+    this.region = this.region || region;
+    return nodes.map(n => n.url);
+  }
+
+  async open(urls) {
+    let results = await Promise.all(urls.map(u => {
+      let health = this.healthOf(u);
+      let connection = new Connection(u, {
+        timeout: this.timeout, lean: this.lean, scheduler: this.scheduler, limiter: this.limiter(u), health,
+        transport: this.transport, compression: this.compression, metrics: this.metricsRegistry,
+        onStatus: (status, c) => this.status(status, c)
+      });
+      health.admit();
+      return this.metricsRegistry.timeAsync("node.connect", () => connection.open()).then(c => {
+        if (health.state !== Breaker.CLOSED) health.reset();
+        return c;
+      }, () => {
+        health.trip("connect failed");
+        this.metricsRegistry.count("node.connect.error");
+        return null;
+      });
+    }));
+    let opened = results.filter(c => c !== null);
+
+    let chainId = this.chainId || majority(opened.map(c => c.chain.chain_id));
+    return opened.filter(c => {
+      if (c.chain.chain_id === chainId) return true;
+      c.health.mismatch();
+      c.close().catch(() => null);
+      return false;
+    });
+  }
+
+  // Status changes of pooled connections; a reconnected socket lost the object subscription.
+  status(status, connection) {
+    if (status === "reconnect" && this.connections.indexOf(connection) !== -1) this.objects.resubscribe(connection);
+  }
+
+  healthOf(url) {
+    let health = this.nodes.get(url);
+    if (!health) {
+      health = new NodeHealth(url, this.healthOptions);
+      this.nodes.set(url, health);
+    }
+    return health;
+  }
+
+  // Probes head blocks of the pool every `interval` ms and tries nodes whose breaker allows a trial.
+  // An automatically selected pool is topped up to poolSize from the current node registry.
+  startHealthChecks(interval = 10000) {
+    this.stopHealthChecks();
+    this.healthTimer = setInterval(() => this.probe().catch(() => null), interval);
+    if (this.healthTimer.unref) this.healthTimer.unref();
+  }
+
+  stopHealthChecks() {
+    if (this.healthTimer) clearInterval(this.healthTimer);
+    this.healthTimer = null;
+  }
+
+  async probe() {
+    let heads = await Promise.all(this.connections.map(c =>
+      c.exec("database", "get_dynamic_global_properties", [], {priority: Priority.BACKGROUND})
+        .then(props => props.head_block_number, () => null)));
+    let best = Math.max.apply(null, heads.filter(h => h !== null).concat(0));
+    this.connections.forEach((c, i) => {
+      if (heads[i] !== null) c.health.observeHead(heads[i], best);
+    });
+
+    let connected = new Set(this.connections.map(c => c.url));
+    if (this.autoSelected) {
+      this.candidates = this.candidates.filter(u => this.registry.has(u));
+    }
+    let retry = this.candidates.filter(u => !connected.has(u) && this.healthOf(u).available());
+    if (retry.length) {
+      this.connections = this.connections.concat(await this.open(retry));
+    }
+
+    let missing = this.poolSize - this.connections.length;
+    if (this.autoSelected && missing > 0) {
+      let urls = await this.selectNodes(missing, new Set(this.connections.map(c => c.url)));
+      this.candidates = this.candidates.concat(urls.filter(u => this.candidates.indexOf(u) === -1));
+      this.connections = this.connections.concat(await this.open(urls));
+    }
+  }
+
+  nodeHealth() {
+    return Array.from(this.nodes.values()).map(h => h.snapshot());
+  }
+
+  api() {
+    if (this.chain() == null) {
       throw "BitShares API not connected. Please use BitShares.connect()"
     }
-    return bitsharesApi
-  },
+    return this.bitsharesApi
+  }
 
-  close: () => {
-    Apis.instance().close()
-    conn.chain = null;
-    conn.connection = null
-  },
-};
+  chain() {
+    return this.connections.length ? this.connections[0].chain : null;
+  }
+
+  // Rate limiter of a node, kept across reconnects so the learned rate survives. A rateLimit
+  // option of false disables limiting.
+  limiter(url) {
+    if (this.rateLimit === false) return null;
+    let limiter = this.limiters.get(url);
+    if (!limiter) {
+      limiter = new RateLimiter(this.rateLimit);
+      this.limiters.set(url, limiter);
+    }
+    return limiter;
+  }
+
+  // Connection with the least load relative to its node's sustainable rate and health. Nodes with
+  // an open breaker are skipped unless no other node is left, a half-open node gets its trial call.
+  connection() {
+    let available = this.connections.filter(c => c.health.available());
+    let best = available.find(c => c.health.state === Breaker.HALF_OPEN) || null;
+    if (!best) {
+      (available.length ? available : this.connections).forEach(c => {
+        if (!best || c.load < best.load) best = c;
+      });
+    }
+    if (!best) {
+      throw "BitShares API not connected. Please use BitShares.connect()"
+    }
+    best.health.admit();
+    return best;
+  }
+
+  // An aborted signal stops the call before it is sent; once sent only the result is dropped.
+  exec(method, params, {api = "database", signal = null, priority = Priority.DEFAULT} = {}) {
+    return this.metricsRegistry.timeAsync(`rpc.${method}`, () => {
+      Deadline.check(signal);
+      return Deadline.race(this.connection().exec(api, method, params, {priority, signal}), signal);
+    });
+  }
+
+  metrics() {
+    return this.metricsRegistry.snapshot();
+  }
 
+  close() {
+    this.stopHealthChecks();
+    let connections = this.connections;
+    this.connections = [];
+    return Promise.all(connections.map(c => c.close()));
+  }
+}
 
+// Default instance, shares the process-wide metrics with the event-loop monitor.
+export const BitShares = new BitSharesClient({metrics: Metrics});
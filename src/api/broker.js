@@ -0,0 +1,202 @@
+import {MessageChannel} from "worker_threads";
+import {BitSharesClient} from "./bitshares";
+import {AssetRegistry} from "./assets";
+import {ObjectStore} from "./objects";
+import {Priority} from "./scheduler";
+import {Monitor} from "../utils/monitor";
+import {Deadline} from "../utils/deadline";
+
+const encoder = new TextEncoder();
+const decoder = new TextDecoder();
+
+const hasCallback = (params) => params.some(p => typeof p === "function");
+
+// Calls the broker answers from its client's caches instead of the node, by `${api}.${method}`.
+// resolve_assets is not a node method: BrokerClients ask for compact assets with it.
+const cached = {
+  "database.get_objects": (client, [ids], priority) => client.objects.getMany(ids, {priority}),
+  "broker.resolve_assets": (client, [keys], priority) => client.assets.resolve(keys, {priority}),
+};
+
+/**
+ * Serves RPCs of BrokerClients in other threads from one client, so every worker shares its node
+ * connections, its object store and its asset registry. Identical calls in flight from any worker
+ * are sent once. Authority records used by login stay per worker, their keys are interned in a
+ * KeyTable of the worker's own.
+ */
+export const Broker = {
+  serve: (client, port) => {
+    let inflight = new Map();
+    let keys = new Map();
+
+    // A cancelled waiter gets no reply; the node call still finishes for the others.
+    const cancel = (id) => {
+      let key = keys.get(id);
+      let ids = key && inflight.get(key);
+      if (ids && ids.indexOf(id) !== -1) ids.splice(ids.indexOf(id), 1);
+      keys.delete(id);
+    };
+
+    const settle = (key) => {
+      let ids = inflight.get(key);
+      inflight.delete(key);
+      ids.forEach(id => keys.delete(id));
+      return ids;
+    };
+
+    const reply = (id, bytes) => port.postMessage({id, bytes}, [bytes.buffer]);
+
+    const call = ({id, api, method, params, priority}) => {
+      let key = `${priority}:${api}:${method}:${JSON.stringify(params)}`;
+      let waiters = inflight.get(key);
+      if (waiters) {
+        client.metricsRegistry.count("broker.dedup");
+        waiters.push(id);
+        keys.set(id, key);
+        return;
+      }
+      inflight.set(key, [id]);
+      keys.set(id, key);
+
+      let lookup = cached[`${api}.${method}`];
+      let answer = lookup ? Promise.resolve().then(() => lookup(client, params, priority))
+        : client.exec(method, params, {api, priority});
+      answer.then(result => {
+        let ids = settle(key);
+        if (!ids.length) return;
+        // Encoded once; every waiter gets its own copy because transferring detaches the buffer.
+        let bytes = encoder.encode(JSON.stringify(result === undefined ? null : result));
+        ids.forEach((waiter, i) => reply(waiter, i === ids.length - 1 ? bytes : bytes.slice()));
+      }, error => {
+        let ids = settle(key);
+        ids.forEach(waiter => port.postMessage({id: waiter, error: String(error && error.message || error)}));
+      });
+    };
+
+    port.on("message", message => {
+      if (message.cancel !== undefined) {
+        cancel(message.cancel);
+        return;
+      }
+      if (message.type === "chain") {
+        port.postMessage({id: message.id, chain: client.chain(), faucet: client.faucet});
+        return;
+      }
+      client.metricsRegistry.count("broker.batch");
+      message.batch.forEach(call);
+    });
+
+    return {
+      close: () => port.close(),
+    };
+  },
+
+  // Creates a channel served by `client` and returns the port to transfer to a worker.
+  channel: (client) => {
+    let {port1, port2} = new MessageChannel();
+    Broker.serve(client, port1);
+    return port2;
+  },
+};
+
+// Asks the broker's registry, which caches for every worker, instead of the node.
+class BrokerAssets extends AssetRegistry {
+  lookup(keys, priority) {
+    return this.client.exec("resolve_assets", [keys], {api: "broker", priority});
+  }
+}
+
+/**
+ * Client for worker threads that sends every RPC to a Broker over a MessagePort. Calls made in
+ * the same tick travel as one message, responses arrive as transferred buffers. Objects are not
+ * cached here: without a subscription of its own the worker would not see them change, so every
+ * get goes to the broker's store.
+ */
+export class BrokerClient extends BitSharesClient {
+  constructor(port, options = {}) {
+    super(Object.assign({faucet: null}, options));
+    this.assets = new BrokerAssets(this);
+    this.objects = new ObjectStore(this, {budget: 0, maxAge: -1});
+    this.port = port;
+    this.nextId = 1;
+    this.pending = new Map();
+    this.queue = [];
+    this.remoteChain = null;
+    this.port.on("message", message => this.receive(message));
+    this.port.unref();
+  }
+
+  async connect() {
+    let {chain, faucet} = await this.request({type: "chain"});
+    this.remoteChain = chain;
+    this.faucet = this.faucet || faucet;
+  }
+
+  chain() {
+    return this.remoteChain;
+  }
+
+  // Aborted calls still queued are never sent; calls already sent are cancelled at the broker.
+  exec(method, params, {api = "database", signal = null, priority = Priority.DEFAULT} = {}) {
+    if (hasCallback(params)) {
+      return Promise.reject(new Error(`${method} with a callback is not supported through the broker`));
+    }
+    return this.metricsRegistry.timeAsync(`rpc.${method}`, () => new Promise((resolve, reject) => {
+      Deadline.check(signal);
+      let id;
+      let unlisten = Deadline.listen(signal, () => {
+        let queued = this.queue.findIndex(call => call.id === id);
+        if (queued !== -1) this.queue.splice(queued, 1);
+        else this.port.postMessage({cancel: id});
+        this.receive({id, error: Deadline.error(signal)});
+      });
+      id = this.track(value => {
+        unlisten();
+        resolve(value);
+      }, error => {
+        unlisten();
+        reject(error);
+      });
+      if (!this.queue.length) setImmediate(() => this.flush());
+      this.queue.push({id, api, method, params, priority});
+    }));
+  }
+
+  request(message) {
+    return new Promise((resolve, reject) => {
+      let id = this.track(resolve, reject);
+      this.port.postMessage(Object.assign({id}, message));
+    });
+  }
+
+  track(resolve, reject) {
+    let id = this.nextId++;
+    if (!this.pending.size) this.port.ref();
+    this.pending.set(id, {resolve, reject});
+    return id;
+  }
+
+  flush() {
+    let batch = this.queue;
+    this.queue = [];
+    if (batch.length) this.port.postMessage({batch});
+  }
+
+  receive(message) {
+    let call = this.pending.get(message.id);
+    if (!call) return;
+    this.pending.delete(message.id);
+    if (!this.pending.size) this.port.unref();
+
+    if (message.error instanceof Error) call.reject(message.error);
+    else if (message.error !== undefined) call.reject(new Error(message.error));
+    else if (message.bytes) call.resolve(Monitor.track("JSONDecode", () => JSON.parse(decoder.decode(message.bytes))));
+    else call.resolve(message);
+  }
+
+  close() {
+    this.remoteChain = null;
+    this.port.close();
+    return Promise.resolve();
+  }
+}
@@ -0,0 +1,124 @@
+import {ChainConfig, ChainWebSocket, GrapheneApi} from "bitsharesjs-ws";
+import {Scheduler} from "./scheduler";
+import {RpcApi, RpcSocket} from "./transport";
+
+const DEFAULT_APIS = ["database", "network_broadcast", "history"];
+
+// Looks the chain up without ChainConfig.setChainId, which would switch the process-wide
+// address prefix under every other client.
+const chainFor = (chainId) => {
+  let networks = ChainConfig.networks || {};
+  for (let name in networks) {
+    if (networks[name].chain_id === chainId) {
+      return Object.assign({name}, networks[name]);
+    }
+  }
+  return {chain_id: chainId};
+};
+
+/**
+ * One websocket to one node with its API sets, owned by a single BitSharesClient. A lean connection
+ * only opens the database API during the handshake and every other API set on first use. With the
+ * "builtin" transport calls go over an RpcSocket and wait in the scheduler while its buffer is full;
+ * only that transport takes the permessage-deflate `compression` settings. `timeout` is the connect
+ * timeout in ms, as ChainWebSocket takes it.
+ */
+export class Connection {
+  constructor(url, {
+    timeout = 5000, autoReconnect = true, apis = DEFAULT_APIS, lean = false, onStatus = null, scheduler = {},
+    limiter = null, health = null, transport = null, compression = false, metrics = null
+  } = {}) {
+    this.url = url;
+    this.timeout = timeout;
+    this.autoReconnect = autoReconnect;
+    this.lean = lean;
+    this.builtin = transport === "builtin";
+    this.compression = compression;
+    this.metrics = metrics;
+    this.apiNames = lean ? ["database"] : apis;
+    this.opening = {};
+    this.onStatus = onStatus;
+    this.ws = null;
+    this.apis = {};
+    this.chain = null;
+    this.limiter = limiter;
+    this.health = health;
+    let onResult = health ? (latency, error) => health.record(latency, error) : null;
+    this.scheduler = new Scheduler(Object.assign({limiter, onResult}, scheduler));
+  }
+
+  // Calls queued or in flight.
+  get pending() {
+    return this.scheduler.pending;
+  }
+
+  // Pending calls relative to what the node currently sustains, weighted by its health; lower is better.
+  get load() {
+    let load = this.limiter ? (this.pending + 1) / this.limiter.rate : this.pending + 1;
+    return this.health ? load * this.health.penalty() : load;
+  }
+
+  async open() {
+    let Socket = this.builtin ? RpcSocket : ChainWebSocket;
+    let settings = this.builtin ? {compression: this.compression, metrics: this.metrics} : null;
+    this.ws = new Socket(this.url, status => this.status(status), this.timeout, this.autoReconnect, settings);
+    this.scheduler.backpressure = this.builtin ? this.ws : null;
+    try {
+      // API sets are requested right behind login on the same socket instead of after its reply.
+      let login = this.ws.login("", "");
+      let apis = this.ws.connect_promise.then(() => Promise.all(this.apiNames.map(name => this.initApi(name))));
+      await Promise.all([login, apis]);
+      this.chain = chainFor(await this.exec("database", "get_chain_id", []));
+    } catch (e) {
+      this.close().catch(() => null);
+      throw e;
+    }
+
+    this.ws.on_reconnect = () => {
+      if (!this.ws) return;
+      this.ws.login("", "")
+        .then(() => Promise.all(Object.keys(this.apis).map(name => this.apis[name].init())))
+        .then(() => this.status("reconnect"))
+        .catch(() => this.status("error"));
+    };
+    return this;
+  }
+
+  initApi(name) {
+    let api = this.builtin ? new RpcApi(this.ws, name) : new GrapheneApi(this.ws, name);
+    return api.init().then(() => {
+      this.apis[name] = api;
+      return api;
+    });
+  }
+
+  openApi(name) {
+    if (!this.opening[name]) {
+      this.opening[name] = this.initApi(name).finally(() => {
+        delete this.opening[name];
+      });
+    }
+    return this.opening[name];
+  }
+
+  exec(api, method, params, {priority, signal} = {}) {
+    if (!this.apis[api]) {
+      if (this.lean && this.ws) {
+        return this.openApi(api).then(() => this.exec(api, method, params, {priority, signal}));
+      }
+      return Promise.reject(new Error(`API ${api} is not open on ${this.url}`));
+    }
+    return this.scheduler.submit(() => this.apis[api].exec(method, params), {priority, signal});
+  }
+
+  status(status) {
+    if (this.onStatus) this.onStatus(status, this);
+  }
+
+  close() {
+    let ws = this.ws;
+    this.ws = null;
+    this.apis = {};
+    return ws ? ws.close() : Promise.resolve();
+  }
+}
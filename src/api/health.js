@@ -0,0 +1,121 @@
+import {isNodeReply, isThrottle} from "./ratelimit";
+
+const now = () => Date.now();
+
+// Whether a failed call says something about the node: a closed socket, a timeout or throttling.
+// Errors the node answered with, such as FC asserts, do not.
+export const isNodeFailure = (error) => !!error && (isThrottle(error) || !isNodeReply(error));
+
+export const Breaker = {
+  CLOSED: "closed",
+  OPEN: "open",
+  HALF_OPEN: "half-open",
+};
+
+/**
+ * Health of one node: EWMA latency and error rate, head block lag behind the best node seen and
+ * chain id, driving a circuit breaker. An open breaker keeps the node out of rotation for
+ * `cooldown` ms (doubling on every failed trial up to `maxCooldown`), then lets `trials` calls
+ * through half-open; a success closes it again. Only node failures count as errors, a call the
+ * node answered with an error is a success for its health.
+ */
+export class NodeHealth {
+  constructor(url, {alpha = 0.2, maxErrorRate = 0.5, maxLag = 10, cooldown = 5000, maxCooldown = 300000, trials = 1} = {}) {
+    this.url = url;
+    this.alpha = alpha;
+    this.maxErrorRate = maxErrorRate;
+    this.maxLag = maxLag;
+    this.baseCooldown = cooldown;
+    this.maxCooldown = maxCooldown;
+    this.trials = trials;
+    this.latency = null;
+    this.errorRate = 0;
+    this.head = null;
+    this.lag = 0;
+    this.chainMismatch = false;
+    this.state = Breaker.CLOSED;
+    this.cooldown = cooldown;
+    this.openedAt = 0;
+    this.inTrial = 0;
+    this.reason = null;
+  }
+
+  record(latency, failure) {
+    let error = isNodeFailure(failure);
+    this.errorRate = (1 - this.alpha) * this.errorRate + this.alpha * (error ? 1 : 0);
+    if (!error) {
+      this.latency = this.latency === null ? latency : (1 - this.alpha) * this.latency + this.alpha * latency;
+    }
+
+    if (this.state === Breaker.HALF_OPEN) {
+      this.inTrial = Math.max(0, this.inTrial - 1);
+      if (error) this.trip("trial failed");
+      else this.reset();
+    } else if (error && this.errorRate > this.maxErrorRate) {
+      this.trip("error rate");
+    }
+  }
+
+  observeHead(head, bestHead) {
+    this.head = head;
+    this.lag = Math.max(0, bestHead - head);
+    if (this.lag > this.maxLag) this.trip("head block lag");
+  }
+
+  mismatch() {
+    this.chainMismatch = true;
+    this.trip("chain id mismatch");
+  }
+
+  trip(reason) {
+    if (this.state === Breaker.HALF_OPEN) {
+      this.cooldown = Math.min(this.maxCooldown, this.cooldown * 2);
+    }
+    this.state = Breaker.OPEN;
+    this.openedAt = now();
+    this.inTrial = 0;
+    this.reason = reason;
+  }
+
+  reset() {
+    this.state = Breaker.CLOSED;
+    this.cooldown = this.baseCooldown;
+    this.errorRate = 0;
+    this.reason = null;
+  }
+
+  // Whether calls may go to this node now. Past the cooldown an open breaker turns half-open and
+  // admits up to `trials` calls. A node on another chain never comes back.
+  available() {
+    if (this.chainMismatch) return false;
+    if (this.state === Breaker.OPEN && now() - this.openedAt >= this.cooldown) {
+      this.state = Breaker.HALF_OPEN;
+      this.inTrial = 0;
+    }
+    if (this.state === Breaker.HALF_OPEN) return this.inTrial < this.trials;
+    return this.state === Breaker.CLOSED;
+  }
+
+  // Called when a call or connect attempt is actually sent to the node.
+  admit() {
+    if (this.state === Breaker.HALF_OPEN) this.inTrial++;
+  }
+
+  // Multiplier on routing load, 1 for a healthy node.
+  penalty() {
+    return 1 + 10 * this.errorRate + this.lag;
+  }
+
+  snapshot() {
+    return {
+      url: this.url,
+      state: this.state,
+      reason: this.reason,
+      latency: this.latency,
+      errorRate: this.errorRate,
+      head: this.head,
+      lag: this.lag,
+      chainMismatch: this.chainMismatch,
+    };
+  }
+}
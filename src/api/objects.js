@@ -0,0 +1,175 @@
+import {Deadline} from "../utils/deadline";
+import {LruCache} from "../utils/cache";
+import {Priority} from "./scheduler";
+
+const defer = typeof setImmediate === "function" ? setImmediate : fn => setTimeout(fn, 0);
+
+const OBJECT_ID = /^(\d+)\.(\d+)\.(\d+)$/;
+
+// Object types by space and type id, as in graphene's protocol and implementation spaces.
+export const ObjectTypes = {
+  1: [
+    null, "base", "account", "asset", "force_settlement", "committee_member", "witness", "limit_order",
+    "call_order", "custom", "proposal", "operation_history", "withdraw_permission", "vesting_balance",
+    "worker", "balance", "htlc",
+  ],
+  2: [
+    "global_property", "dynamic_global_property", null, "asset_dynamic_data", "asset_bitasset_data",
+    "account_balance", "account_statistics", "transaction", "block_summary", "account_transaction_history",
+    "blinded_balance", "chain_property", "witness_schedule", "budget_record", "special_authority",
+    "buyback", "fba_accumulator", "collateral_bid",
+  ],
+};
+
+// Type name of an object id such as "1.2.17" or "2.1.0", null for anything else.
+export const objectType = (id) => {
+  let match = typeof id === "string" && OBJECT_ID.exec(id);
+  if (!match) return null;
+  let types = ObjectTypes[match[1]];
+  return (types && types[Number(match[2])]) || null;
+};
+
+/**
+ * Chain objects of one client by id. Every get() of the same tick is queued and sent as get_objects
+ * calls of at most chunkSize distinct ids, one batch per priority, and ids already in flight are
+ * joined. Results are cached within `budget` bytes. Each connection of the pool gets a
+ * set_subscribe_callback so the node pushes changes of every object it served: changed objects are
+ * replaced in the cache and removed ones dropped. The node forgets the callback with the socket,
+ * so a reconnected connection is subscribed again. Entries older than `maxAge` are fetched again,
+ * which covers notices lost while a connection was down.
+ */
+export class ObjectStore {
+  constructor(client, {chunkSize = 100, budget = 16 * 1024 * 1024, maxAge = 60000} = {}) {
+    this.client = client;
+    this.chunkSize = chunkSize;
+    this.maxAge = maxAge;
+    this.cache = new LruCache({name: "objects", budget});
+    this.inflight = new Map();
+    this.queues = new Map();
+    this.scheduled = false;
+    this.subscribed = new WeakSet();
+    this.onNotice = notices => this.notice(notices);
+  }
+
+  // An object by id, null if it does not exist. With `type` the id must name an object of that type.
+  async get(id, {signal = null, priority = Priority.DEFAULT, type = null} = {}) {
+    let [object] = await this.getMany([id], {signal, priority, type});
+    return object;
+  }
+
+  // Objects by id in order, null for ids that do not exist. Aborting only abandons the wait.
+  async getMany(ids, {signal = null, priority = Priority.DEFAULT, type = null} = {}) {
+    Deadline.check(signal);
+    ids.forEach(id => {
+      let actual = objectType(id);
+      if (!actual || (type && actual !== type)) {
+        throw new Error(type ? `Expected a ${type} id, got ${id}` : `Not an object id: ${id}`);
+      }
+    });
+
+    let found = new Map();
+    let waiting = [];
+    new Set(ids).forEach(id => {
+      let entry = this.cache.get(id);
+      if (entry && Date.now() - entry.fetched <= this.maxAge) {
+        found.set(id, entry.object);
+        return;
+      }
+      let pending = this.inflight.get(id) || this.enqueue(id, priority);
+      waiting.push(pending.then(object => found.set(id, object)));
+    });
+    if (waiting.length) await Deadline.race(Promise.all(waiting), signal);
+    return ids.map(id => found.get(id));
+  }
+
+  // Drops an object from the cache, the next get fetches it again.
+  invalidate(id) {
+    this.cache.delete(id);
+  }
+
+  clear() {
+    this.cache.clear();
+  }
+
+  enqueue(id, priority) {
+    let queue = this.queues.get(priority);
+    if (!queue) {
+      queue = new Map();
+      this.queues.set(priority, queue);
+    }
+    let waiter = {resolve: null, reject: null};
+    let promise = new Promise((resolve, reject) => {
+      waiter.resolve = resolve;
+      waiter.reject = reject;
+    });
+    queue.set(id, waiter);
+    this.inflight.set(id, promise);
+    if (!this.scheduled) {
+      this.scheduled = true;
+      defer(() => this.flush());
+    }
+    return promise;
+  }
+
+  flush() {
+    this.scheduled = false;
+    let queues = this.queues;
+    this.queues = new Map();
+    this.subscribe();
+    queues.forEach((queue, priority) => {
+      let ids = Array.from(queue.keys());
+      for (let i = 0; i < ids.length; i += this.chunkSize) {
+        this.fetchChunk(ids.slice(i, i + this.chunkSize), queue, priority);
+      }
+    });
+  }
+
+  fetchChunk(ids, queue, priority) {
+    this.client.exec("get_objects", [ids], {priority}).then(objects => {
+      let fetched = Date.now();
+      ids.forEach((id, i) => {
+        let object = objects[i] || null;
+        this.store(id, object, fetched);
+        this.inflight.delete(id);
+        queue.get(id).resolve(object);
+      });
+    }, error => {
+      this.client.metricsRegistry.count("objects.error");
+      ids.forEach(id => {
+        this.inflight.delete(id);
+        queue.get(id).reject(error);
+      });
+    });
+  }
+
+  store(id, object, fetched = Date.now()) {
+    this.cache.set(id, {object, fetched});
+  }
+
+  // Asks every pooled connection not yet subscribed to push changes of the objects it serves.
+  subscribe() {
+    this.client.connections.forEach(connection => {
+      if (this.subscribed.has(connection)) return;
+      this.subscribed.add(connection);
+      connection.exec("database", "set_subscribe_callback", [this.onNotice, false], {priority: Priority.INTERACTIVE})
+        .catch(() => this.subscribed.delete(connection));
+    });
+  }
+
+  // Called by the client once a connection is back up on a new socket.
+  resubscribe(connection) {
+    this.subscribed.delete(connection);
+    this.subscribe();
+  }
+
+  // Notices carry changed objects and ids of removed ones; only cached ids are touched.
+  notice(update) {
+    if (Array.isArray(update)) {
+      update.forEach(item => this.notice(item));
+    } else if (typeof update === "string") {
+      this.cache.delete(update);
+    } else if (update && update.id && this.cache.has(update.id)) {
+      this.store(update.id, update);
+    }
+  }
+}
@@ -0,0 +1,128 @@
+import http from "http";
+import https from "https";
+import {Settings} from "../settings";
+import {Metrics} from "../utils/metrics";
+import {LruCache} from "../utils/cache";
+
+require('isomorphic-fetch');
+
+const api = Settings.API.OpenLedger;
+
+const query = (params) => Object.keys(params).sort()
+  .filter(key => params[key] !== undefined && params[key] !== null)
+  .map(key => `${encodeURIComponent(key)}=${encodeURIComponent(params[key])}`)
+  .join("&");
+
+// Returns the freshness lifetime in ms, 0 to always revalidate or -1 to not store at all.
+const lifetime = (cacheControl, fallback) => {
+  if (!cacheControl) return fallback;
+  if (/no-store/i.test(cacheControl)) return -1;
+  if (/no-cache/i.test(cacheControl)) return 0;
+  let maxAge = /max-age=(\d+)/i.exec(cacheControl);
+  return maxAge ? parseInt(maxAge[1], 10) * 1000 : fallback;
+};
+
+/**
+ * Client of the OpenLedger support API. GET responses of the list endpoints are cached in memory
+ * within `budget` bytes honoring Cache-Control and revalidated with ETag / Last-Modified; identical
+ * requests in flight share one fetch.
+ */
+export class OpenLedgerClient {
+  constructor({base = api.BASE, ttl = 60000, agent = null, maxSockets = 8, budget = 4 * 1024 * 1024} = {}) {
+    this.base = base;
+    this.ttl = ttl;
+    this.agent = agent || (typeof window === "undefined" ?
+      new (base.startsWith("https:") ? https : http).Agent({keepAlive: true, maxSockets}) : null);
+    this.cache = new LruCache({name: "openledger", budget});
+    this.inflight = new Map();
+  }
+
+  /** @returns {Promise<Array<Object>>} coins supported by the gateway */
+  coins() {
+    return this.cached(api.COINS_LIST);
+  }
+
+  /** @returns {Promise<Array<Object>>} wallets currently accepting deposits */
+  activeWallets() {
+    return this.cached(api.ACTIVE_WALLETS);
+  }
+
+  /** @returns {Promise<Array<Object>>} pairs the gateway converts between */
+  tradingPairs() {
+    return this.cached(api.TRADING_PAIRS);
+  }
+
+  /** @returns {Promise<Object>} deposit limit of a coin pair */
+  depositLimit(inputCoinType, outputCoinType) {
+    return this.cached(`${api.DEPOSIT_LIMIT}?${query({inputCoinType, outputCoinType})}`);
+  }
+
+  /** @returns {Promise<Object>} output amount for the given input, never cached */
+  estimateOutput(inputAmount, inputCoinType, outputCoinType) {
+    return this.coalesced(`${api.ESTIMATE_OUTPUT}?${query({inputAmount, inputCoinType, outputCoinType})}`);
+  }
+
+  /** @returns {Promise<Object>} input amount needed for the given output, never cached */
+  estimateInput(outputAmount, inputCoinType, outputCoinType) {
+    return this.coalesced(`${api.ESTIMATE_INPUT}?${query({outputAmount, inputCoinType, outputCoinType})}`);
+  }
+
+  clear() {
+    this.cache.clear();
+  }
+
+  cached(path) {
+    let entry = this.cache.get(path);
+    if (entry && Date.now() < entry.expires) {
+      Metrics.count("openledger.cache.hit");
+      return Promise.resolve(entry.body);
+    }
+    Metrics.count("openledger.cache.miss");
+    return this.coalesced(path, true);
+  }
+
+  coalesced(path, cacheable = false) {
+    let pending = this.inflight.get(path);
+    if (pending) return pending;
+    pending = this.request(path, cacheable).finally(() => this.inflight.delete(path));
+    this.inflight.set(path, pending);
+    return pending;
+  }
+
+  async request(path, cacheable) {
+    let entry = cacheable ? this.cache.peek(path) : null;
+    let headers = {Accept: "application/json"};
+    if (entry && entry.etag) headers["If-None-Match"] = entry.etag;
+    if (entry && entry.lastModified) headers["If-Modified-Since"] = entry.lastModified;
+
+    let res = await Metrics.timeAsync(`openledger.${path.split("?")[0]}`, () =>
+      fetch(this.base + path, {method: "get", headers, agent: this.agent}));
+    let ttl = lifetime(res.headers.get("cache-control"), this.ttl);
+
+    if (res.status === 304 && entry) {
+      Metrics.count("openledger.cache.revalidated");
+      entry.expires = Date.now() + Math.max(0, ttl);
+      return entry.body;
+    }
+    if (!res.ok) {
+      throw new Error(`OpenLedger ${path} failed with status ${res.status}`);
+    }
+
+    let body = await res.json();
+    if (cacheable) {
+      if (ttl < 0) {
+        this.cache.delete(path);
+      } else {
+        this.cache.set(path, {
+          body,
+          etag: res.headers.get("etag"),
+          lastModified: res.headers.get("last-modified"),
+          expires: Date.now() + ttl,
+        });
+      }
+    }
+    return body;
+  }
+}
+
+export const OpenLedger = new OpenLedgerClient();
@@ -0,0 +1,93 @@
+const now = () => Date.now();
+
+const TOO_MANY_REQUESTS = /\btoo many requests\b/i;
+
+// Whether an error is the node's answer to a call: ChainWebSocket rejects with the raw error of the
+// reply, RpcSocket marks its errors with `reply`.
+export const isNodeReply = (error) => !!error && (error.reply === true || !(error instanceof Error));
+
+// Throttling by the node or a proxy in front of it: status 429, or its reason phrase on a transport
+// error. Texts of node replies are not matched, asserts mention ids and limits of all kinds.
+export const isThrottle = (error) => !!error && (error.code === 429 || error.status === 429 ||
+  (!isNodeReply(error) && TOO_MANY_REQUESTS.test(String(error.message))));
+
+/**
+ * Token bucket of one node with an adaptive rate. The rate is cut in half on throttle errors and
+ * by a fifth when latency inflates past `inflation` times its baseline, and grows by `step` per
+ * `probeInterval` while calls are actually held back by the bucket and the node stays healthy.
+ */
+export class RateLimiter {
+  constructor({rate = 50, minRate = 2, maxRate = 1000, burst = null, step = 5, probeInterval = 1000, inflation = 3, cooldown = 500} = {}) {
+    this.rate = rate;
+    this.minRate = minRate;
+    this.maxRate = maxRate;
+    this.burst = burst;
+    this.step = step;
+    this.probeInterval = probeInterval;
+    this.inflation = inflation;
+    this.cooldown = cooldown;
+    this.tokens = this.capacity();
+    this.last = now();
+    this.latency = null;
+    this.baseline = null;
+    this.limited = false;
+    this.lastChange = 0;
+    this.throttled = 0;
+  }
+
+  capacity() {
+    return this.burst || Math.max(1, this.rate / 5);
+  }
+
+  refill() {
+    let at = now();
+    this.tokens = Math.min(this.capacity(), this.tokens + (at - this.last) * this.rate / 1000);
+    this.last = at;
+  }
+
+  // Takes a token and returns 0, or returns the ms until one is available.
+  take() {
+    this.refill();
+    if (this.tokens >= 1) {
+      this.tokens--;
+      return 0;
+    }
+    this.limited = true;
+    return Math.max(1, Math.ceil((1 - this.tokens) * 1000 / this.rate));
+  }
+
+  record(latency, error) {
+    if (isThrottle(error)) {
+      this.throttled++;
+      this.decrease(0.5);
+      return;
+    }
+    if (error) return;
+
+    this.latency = this.latency === null ? latency : 0.8 * this.latency + 0.2 * latency;
+    // The baseline follows the lowest latency seen and drifts up slowly so a node that got
+    // permanently slower is not punished forever.
+    this.baseline = this.baseline === null ? this.latency : Math.min(this.latency, this.baseline * 1.001);
+
+    if (this.latency > this.baseline * this.inflation) {
+      this.decrease(0.8);
+    } else if (this.limited && now() - this.lastChange > this.probeInterval) {
+      this.rate = Math.min(this.maxRate, this.rate + this.step);
+      this.lastChange = now();
+      this.limited = false;
+    }
+  }
+
+  // Decreases at most once per cooldown, a burst of failures from one window counts once.
+  decrease(factor) {
+    if (now() - this.lastChange < this.cooldown) return;
+    this.rate = Math.max(this.minRate, this.rate * factor);
+    this.tokens = Math.min(this.tokens, this.capacity());
+    this.lastChange = now();
+    this.limited = false;
+  }
+
+  snapshot() {
+    return {rate: this.rate, latency: this.latency, baseline: this.baseline, throttled: this.throttled};
+  }
+}
@@ -0,0 +1,153 @@
+import fs from "fs";
+import {Settings} from "../settings";
+
+const DEFAULT_PORTS = {"ws:": "80", "wss:": "443"};
+
+const LOCAL = /^(127\.0\.0\.1|localhost|\[::1\])$/;
+
+// Canonical form of a node url: trimmed, lowercase scheme and host, no default port and no trailing
+// slash. Returns null for anything that is not a ws:// or wss:// url.
+export const normalizeUrl = (url) => {
+  if (typeof url !== "string") return null;
+  let parsed;
+  try {
+    parsed = new URL(url.trim());
+  } catch (e) {
+    return null;
+  }
+  if (!DEFAULT_PORTS[parsed.protocol] || !parsed.hostname) return null;
+  let port = parsed.port && parsed.port !== DEFAULT_PORTS[parsed.protocol] ? `:${parsed.port}` : "";
+  let path = parsed.pathname.replace(/\/+$/, "");
+  return `${parsed.protocol}//${parsed.hostname.toLowerCase()}${port}${path}${parsed.search}`;
+};
+
+const isLocal = (url) => LOCAL.test(new URL(url).hostname);
+
+// A missing operator file is an empty source, any other read error is thrown.
+const missing = (e) => {
+  if (e.code !== "ENOENT") throw e;
+  return null;
+};
+
+// Operator lists are JSON arrays of urls or node objects, or plain urls separated by commas or whitespace.
+const parseList = (text) => {
+  let trimmed = text.trim();
+  if (!trimmed) return [];
+  if (trimmed[0] === "[") return JSON.parse(trimmed);
+  return trimmed.split(/[\s,]+/).filter(u => u);
+};
+
+/**
+ * The nodes a client may connect to: the built-in Settings.Nodes without the automatic-selection
+ * placeholder and the local node, merged with operator lists from a file and an environment
+ * variable. Urls are normalized and deduped, operator entries override built-in metadata. Both
+ * operator sources are read once at construction and again on every reload().
+ */
+export class NodeRegistry {
+  constructor({builtin = Settings.Nodes, path = null, env = "BITSHARES_NODES", onChange = null} = {}) {
+    this.builtin = builtin;
+    this.path = path;
+    this.env = env;
+    this.operator = [];
+    this.entries = new Map();
+    this.timer = null;
+    let file = null;
+    if (path) {
+      try {
+        file = fs.readFileSync(path, "utf8");
+      } catch (e) {
+        file = missing(e);
+      }
+    }
+    this.load(file);
+    this.onChange = onChange;
+  }
+
+  list({testnet = false} = {}) {
+    let res = [];
+    this.entries.forEach(node => {
+      if (/^TESTNET/.test(node.region || "") === testnet) res.push(node);
+    });
+    return res;
+  }
+
+  has(url) {
+    return this.entries.has(normalizeUrl(url));
+  }
+
+  // Re-reads the operator environment variable and file, the file wins on duplicates. A source
+  // that fails to parse keeps its last good list. Resolves to the urls added and removed.
+  async reload() {
+    let file = null;
+    if (this.path) {
+      try {
+        file = await fs.promises.readFile(this.path, "utf8");
+      } catch (e) {
+        file = missing(e);
+      }
+    }
+    return this.load(file);
+  }
+
+  // Rebuilds from the operator file text, null without one, and the environment variable.
+  load(file) {
+    let texts = {env: null, file};
+    if (this.env && typeof process !== "undefined" && process.env[this.env]) {
+      texts.env = process.env[this.env];
+    }
+    let operator = [];
+    ["env", "file"].forEach(source => {
+      if (texts[source] === null) return;
+      let nodes;
+      try {
+        nodes = parseList(texts[source]).map(entry =>
+          Object.assign(typeof entry === "string" ? {url: entry} : Object.assign({}, entry), {source}));
+      } catch (e) {
+        nodes = this.operator.filter(node => node.source === source);
+      }
+      operator = operator.concat(nodes);
+    });
+    this.operator = operator;
+    return this.rebuild();
+  }
+
+  // Reloads every `interval` ms. Live connections are not touched, clients only stop picking
+  // removed nodes and start seeing added ones.
+  watch(interval = 60000) {
+    this.unwatch();
+    this.timer = setInterval(() => this.reload().catch(() => null), interval);
+    if (this.timer.unref) this.timer.unref();
+  }
+
+  unwatch() {
+    if (this.timer) clearInterval(this.timer);
+    this.timer = null;
+  }
+
+  rebuild() {
+    let entries = new Map();
+    let add = (node, builtin) => {
+      let url = normalizeUrl(node.url);
+      if (!url || url === normalizeUrl(Settings.DefaultNode)) return;
+      if (builtin && isLocal(url)) return;
+      entries.set(url, Object.assign({}, entries.get(url), node, {url}));
+    };
+    this.builtin.forEach(node => add(node, true));
+    this.operator.forEach(node => add(node, false));
+
+    let added = [];
+    let removed = [];
+    entries.forEach((node, url) => {
+      if (!this.entries.has(url)) added.push(url);
+    });
+    this.entries.forEach((node, url) => {
+      if (!entries.has(url)) removed.push(url);
+    });
+    this.entries = entries;
+    if ((added.length || removed.length) && this.onChange) this.onChange({added, removed});
+    return {added, removed};
+  }
+}
+
+// Shared registry of the default client.
+export const Nodes = new NodeRegistry();
@@ -0,0 +1,161 @@
+import {Deadline} from "../utils/deadline";
+
+export const Priority = {
+  INTERACTIVE: "interactive",
+  DEFAULT: "default",
+  BACKGROUND: "background",
+};
+
+const CLASSES = [Priority.INTERACTIVE, Priority.DEFAULT, Priority.BACKGROUND];
+
+const DEFAULT_WEIGHTS = {
+  [Priority.INTERACTIVE]: 16,
+  [Priority.DEFAULT]: 4,
+  [Priority.BACKGROUND]: 1,
+};
+
+const now = () => Date.now();
+
+/**
+ * Admits calls of one connection by priority class with weighted fair queuing: each call gets a
+ * virtual finish tag of 1 / weight after its predecessor in the class, and the smallest tag runs
+ * next. The last `reserved` slots are kept for interactive calls so a login never waits for bulk
+ * traffic to drain. A default or background call queued longer than `maxWait` runs before fresher
+ * calls of those classes, but never ahead of an interactive call, whatever bulk has aged. With a
+ * limiter every call also needs a token of the node's rate limiter before it is sent, and with a
+ * backpressure source ({writable, onDrain}) calls wait while the socket buffer is full.
+ */
+export class Scheduler {
+  constructor({
+    concurrency = 64, reserved = 8, weights = DEFAULT_WEIGHTS, maxWait = 1000, limiter = null, onResult = null,
+    backpressure = null
+  } = {}) {
+    this.concurrency = concurrency;
+    this.reserved = Math.min(reserved, concurrency - 1);
+    this.weights = Object.assign({}, DEFAULT_WEIGHTS, weights);
+    this.maxWait = maxWait;
+    this.limiter = limiter;
+    this.onResult = onResult;
+    this.backpressure = backpressure;
+    this.blocked = false;
+    this.timer = null;
+    this.queues = {};
+    this.finish = {};
+    CLASSES.forEach(cls => {
+      this.queues[cls] = [];
+      this.finish[cls] = 0;
+    });
+    this.vtime = 0;
+    this.active = 0;
+    this.queued = 0;
+  }
+
+  get pending() {
+    return this.active + this.queued;
+  }
+
+  submit(fn, {priority = Priority.DEFAULT, signal = null} = {}) {
+    Deadline.check(signal);
+    let cls = this.queues[priority] ? priority : Priority.DEFAULT;
+
+    return new Promise((resolve, reject) => {
+      let tag = Math.max(this.vtime, this.finish[cls]) + 1 / this.weights[cls];
+      this.finish[cls] = tag;
+      let task = {fn, resolve, reject, tag, cls, enqueued: now(), unlisten: null};
+      task.unlisten = Deadline.listen(signal, () => {
+        let queue = this.queues[cls];
+        let i = queue.indexOf(task);
+        if (i === -1) return;
+        queue.splice(i, 1);
+        this.queued--;
+        reject(Deadline.error(signal));
+      });
+      this.queues[cls].push(task);
+      this.queued++;
+      this.drain();
+    });
+  }
+
+  next() {
+    let at = now();
+    let best = null;
+    let bestAged = false;
+    if (this.active < this.concurrency - this.reserved) {
+      [Priority.DEFAULT, Priority.BACKGROUND].forEach(cls => {
+        let head = this.queues[cls][0];
+        if (!head) return;
+        let aged = at - head.enqueued > this.maxWait;
+        if (!best ||
+          (aged && !bestAged) ||
+          (aged && bestAged && head.enqueued < best.enqueued) ||
+          (aged === bestAged && !aged && head.tag < best.tag)) {
+          best = head;
+          bestAged = aged;
+        }
+      });
+    }
+    let interactive = this.queues[Priority.INTERACTIVE][0];
+    if (interactive && (!best || bestAged || interactive.tag <= best.tag)) return interactive;
+    return best;
+  }
+
+  drain() {
+    while (this.active < this.concurrency) {
+      let task = this.next();
+      if (!task) return;
+      if (this.backpressure && !this.backpressure.writable) {
+        this.block();
+        return;
+      }
+      let wait = this.limiter ? this.limiter.take() : 0;
+      if (wait > 0) {
+        this.wake(wait);
+        return;
+      }
+      this.queues[task.cls].shift();
+      this.queued--;
+      this.active++;
+      this.vtime = Math.max(this.vtime, task.tag);
+      task.unlisten();
+
+      let started = now();
+      let done = (error) => {
+        this.active--;
+        let latency = now() - started;
+        if (this.limiter) this.limiter.record(latency, error);
+        if (this.onResult) this.onResult(latency, error);
+        this.drain();
+      };
+      let run;
+      try {
+        run = Promise.resolve(task.fn());
+      } catch (e) {
+        run = Promise.reject(e);
+      }
+      run.then(value => {
+        done(null);
+        task.resolve(value);
+      }, error => {
+        done(error);
+        task.reject(error);
+      });
+    }
+  }
+
+  block() {
+    if (this.blocked) return;
+    this.blocked = true;
+    this.backpressure.onDrain(() => {
+      this.blocked = false;
+      this.drain();
+    });
+  }
+
+  wake(ms) {
+    if (this.timer) return;
+    this.timer = setTimeout(() => {
+      this.timer = null;
+      this.drain();
+    }, ms);
+  }
+}
@@ -0,0 +1,117 @@
+import {ChainWebSocket} from "bitsharesjs-ws";
+import {Nodes} from "./registry";
+
+const CONTINENTS = {
+  Europe: ["Northern Europe", "Western Europe", "Southern Europe", "Eastern Europe"],
+  Asia: ["Northern Asia", "Western Asia", "Southern Asia", "Eastern Asia", "Central Asia", "Southeastern Asia"],
+  Oceania: ["Australia", "New Zealand", "Melanesia", "Polynesia", "Micronesia"],
+  Africa: ["Northern Africa", "Western Africa", "Middle Africa", "Eastern Africa", "Southern Africa"],
+  Americas: ["Northern America", "Central America", "Caribbean", "South America"],
+};
+
+// Continents in the order a search widens from each of them.
+const NEIGHBOURS = {
+  Europe: ["Africa", "Asia", "Americas", "Oceania"],
+  Asia: ["Oceania", "Europe", "Africa", "Americas"],
+  Oceania: ["Asia", "Americas", "Europe", "Africa"],
+  Africa: ["Europe", "Asia", "Americas", "Oceania"],
+  Americas: ["Europe", "Oceania", "Asia", "Africa"],
+};
+
+// Region spellings used in Settings.Nodes that are not one of Settings.NodeRegions.
+const ALIASES = {
+  "North America": "Northern America",
+  "North China": "Eastern Asia",
+  "South China": "Eastern Asia",
+  "Asia": "Asia",
+  "Europe": "Europe",
+};
+
+const TESTNET = /^TESTNET\s*-\s*/;
+
+const continentOf = (region) => {
+  if (CONTINENTS[region]) return region;
+  for (let continent in CONTINENTS) {
+    if (CONTINENTS[continent].indexOf(region) !== -1) return continent;
+  }
+  return null;
+};
+
+// Normalized region of a node, a region of Settings.NodeRegions, a continent name or null.
+export const nodeRegion = (node) => {
+  let region = (node.region || "").replace(TESTNET, "");
+  region = ALIASES[region] || region;
+  return continentOf(region) ? region : null;
+};
+
+// Nodes grouped in rings of growing distance from `region`: the region itself, its continent,
+// neighbouring continents in order, then nodes of unknown region.
+export const regionRings = (nodes, region) => {
+  let continent = continentOf(region);
+  let order = continent ? [continent].concat(NEIGHBOURS[continent]) : Object.keys(CONTINENTS);
+  let rings = [[]];
+  order.forEach(() => rings.push([]));
+  let unknown = [];
+
+  nodes.forEach(node => {
+    let r = nodeRegion(node);
+    if (!r) unknown.push(node);
+    else if (region && r === region) rings[0].push(node);
+    else rings[1 + order.indexOf(continentOf(r))].push(node);
+  });
+  return rings.concat([unknown]).filter(ring => ring.length);
+};
+
+// Time to open a socket and log in, or null when the node does not answer within `timeout` ms.
+const loginRtt = (url, timeout) => {
+  let start = Date.now();
+  let ws;
+  try {
+    ws = new ChainWebSocket(url, null, timeout, false, null);
+  } catch (e) {
+    return Promise.resolve(null);
+  }
+  return ws.login("", "").then(() => Date.now() - start, () => null).then(rtt => {
+    Promise.resolve().then(() => ws.close()).catch(() => null);
+    return rtt;
+  });
+};
+
+export const NodeSelector = {
+  // Probes the nodes nearest to `region` first and widens outward ring by ring until `count` nodes
+  // answered. Without a region one is inferred from probing two nodes per continent. `probe(url)`
+  // resolves to a round trip time or null and defaults to a login with a `timeout` in ms. Resolves
+  // to {region, nodes: [{url, rtt}] sorted by rtt within each ring, failed: [url]}.
+  select: async ({region = null, count = 1, timeout = 3000, probe = null, skip = null, testnet = false, nodes = null} = {}) => {
+    let candidates = (nodes || Nodes.list({testnet})).filter(node => !skip || !skip(node.url));
+    let measure = probe || (url => loginRtt(url, timeout));
+    let rtts = new Map();
+
+    let run = async (ring) => {
+      let todo = ring.filter(node => !rtts.has(node.url));
+      let results = await Promise.all(todo.map(node => measure(node.url)));
+      todo.forEach((node, i) => rtts.set(node.url, results[i]));
+      return ring.filter(node => rtts.get(node.url) !== null)
+        .map(node => ({url: node.url, region: nodeRegion(node), rtt: rtts.get(node.url)}));
+    };
+
+    if (!region) {
+      let located = candidates.filter(node => nodeRegion(node));
+      let samples = [].concat.apply([], regionRings(located, null).map(ring => ring.slice(0, 2)));
+      let nearest = (await run(samples)).sort((a, b) => a.rtt - b.rtt)[0];
+      region = nearest ? nearest.region : null;
+    }
+
+    let selected = [];
+    let rings = regionRings(candidates, region);
+    for (let i = 0; i < rings.length && selected.length < count; i++) {
+      selected = selected.concat((await run(rings[i])).sort((a, b) => a.rtt - b.rtt));
+    }
+
+    let failed = [];
+    rtts.forEach((rtt, url) => {
+      if (rtt === null) failed.push(url);
+    });
+    return {region, nodes: selected.slice(0, count), failed};
+  },
+};
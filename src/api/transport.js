@@ -0,0 +1,443 @@
+import WebSocket from "ws";
+import {Monitor} from "../utils/monitor";
+
+const SUBSCRIBE = {
+  set_subscribe_callback: true,
+  subscribe_to_market: true,
+  set_pending_transaction_callback: true,
+  set_block_applied_callback: true,
+  broadcast_transaction_with_callback: true,
+};
+
+// Key a subscription is replayed under after a reconnect, null for calls that are not replayed.
+// Callback setters replace each other, market subscriptions are one per pair of assets.
+const replayKey = (method, params) => {
+  if (method === "subscribe_to_market") return `market:${JSON.stringify(params.slice(1))}`;
+  return SUBSCRIBE[method] && method !== "broadcast_transaction_with_callback" ? method : null;
+};
+
+// Responses above this size are decoded under the monitor so stalls get attributed to them.
+const LARGE_MESSAGE = 64 * 1024;
+
+const closedError = (url) => new Error(`Connection to ${url} closed`);
+
+// ws errors of a failed upgrade: the server answered other than 101, e.g. a proxy refusing the
+// extension offer, or accepted with extension parameters the client cannot use.
+const HANDSHAKE = /unexpected server response|extension/i;
+
+// UTF-8 size of a received payload. ws hands text frames over as strings or buffers depending on
+// its version; browsers only give strings and no Buffer, their length has to do there.
+const byteLength = (data) => {
+  if (typeof data !== "string") return data.length;
+  return typeof Buffer !== "undefined" ? Buffer.byteLength(data, "utf8") : data.length;
+};
+
+const cpuTime = () => {
+  if (typeof process === "undefined" || !process.cpuUsage) return 0;
+  let usage = process.cpuUsage();
+  return (usage.user + usage.system) / 1000;
+};
+
+// ws options for permessage-deflate. `true` takes the defaults; an object tunes the zlib level,
+// memLevel and the window bits each side may use, and the message size below which no compression
+// is applied. Browsers negotiate compression on their own and ignore these options.
+const deflateOptions = (compression) => {
+  if (!compression) return false;
+  let {level = 1, memLevel = 8, windowBits = 15, serverWindowBits = 15, threshold = 1024} =
+    compression === true ? {} : compression;
+  return {
+    clientMaxWindowBits: windowBits,
+    serverMaxWindowBits: serverWindowBits,
+    zlibDeflateOptions: {level, memLevel},
+    zlibInflateOptions: {windowBits: Math.max(windowBits, serverWindowBits)},
+    threshold,
+  };
+};
+
+/**
+ * JSON-RPC over one websocket, wire compatible with ChainWebSocket. Calls are pipelined without
+ * limit and tracked in a power-of-two table indexed by id, the request text is built from a cached
+ * per api/method prefix, and results settle the caller's promise directly without wrappers.
+ * `writable` turns false while more than `highWaterMark` bytes wait in the socket buffer.
+ *
+ * With `compression` the socket offers permessage-deflate; a node that declines gets plain frames
+ * and a node whose handshake fails with the offer is retried once without it. Received wire and
+ * payload bytes, decode time and process CPU per payload MB go to `metrics`.
+ */
+export class RpcSocket {
+  constructor(url, statusCb = null, connectTimeout = 5000, autoReconnect = true, settings = null) {
+    let {highWaterMark = 1 << 20, options = {}, compression = false, metrics = null} = settings || {};
+    this.url = url;
+    this.statusCb = statusCb;
+    this.connectTimeout = connectTimeout;
+    this.autoReconnect = autoReconnect;
+    this.highWaterMark = highWaterMark;
+    this.options = options;
+    this.compression = compression;
+    this.compressed = false;
+    this.metrics = metrics;
+    this.wireBytes = 0;
+    this.payloadBytes = 0;
+    this.bytesRead = 0;
+    this.cpuMark = cpuTime();
+    this.cpuBytes = 0;
+    this.on_reconnect = null;
+    this.nextId = 1;
+    this.size = 64;
+    this.ids = new Int32Array(this.size);
+    this.resolves = new Array(this.size);
+    this.rejects = new Array(this.size);
+    this.inflight = 0;
+    this.templates = new Map();
+    this.subs = new Map();
+    this.drainWaiters = [];
+    this.drainTimer = null;
+    this.closing = false;
+    this.retries = 0;
+    this.reconnectTimer = null;
+    this.connect_promise = this.open();
+  }
+
+  open() {
+    if (!this.compression) return this.connect(false);
+    return this.connect(true).catch(error => {
+      // Some proxies in front of nodes reject the extension offer outright. A node that is down or
+      // too slow is not retried, that is up to the reconnect backoff.
+      if (!error.handshake) throw error;
+      this.compression = false;
+      this.count("transport.deflate.fallback");
+      return this.connect(false);
+    });
+  }
+
+  connect(compress) {
+    return new Promise((resolve, reject) => {
+      let options = Object.assign({}, this.options, {perMessageDeflate: deflateOptions(compress && this.compression)});
+      let ws = new WebSocket(this.url, [], options);
+      let timer = setTimeout(() => {
+        ws.onopen = ws.onerror = ws.onclose = null;
+        try {
+          ws.close();
+        } catch (e) {
+          // already closing
+        }
+        reject(new Error(`Connection to ${this.url} timed out`));
+      }, this.connectTimeout);
+
+      ws.onopen = () => {
+        clearTimeout(timer);
+        // close() came while this socket was connecting, nobody would ever close it.
+        if (this.closing) {
+          ws.onclose = ws.onerror = null;
+          ws.close();
+          reject(closedError(this.url));
+          return;
+        }
+        this.ws = ws;
+        this.retries = 0;
+        this.bytesRead = 0;
+        this.compressed = /permessage-deflate/.test(ws.extensions || "");
+        if (compress) this.count(this.compressed ? "transport.deflate.negotiated" : "transport.deflate.declined");
+        ws.onmessage = event => this.receive(event.data);
+        ws.onclose = () => this.closed();
+        ws.onerror = () => this.status("error");
+        this.status("open");
+        resolve();
+      };
+      ws.onerror = event => {
+        clearTimeout(timer);
+        let handshake = HANDSHAKE.test((event && event.message) || "");
+        reject(Object.assign(new Error(`Could not connect to ${this.url}`), {handshake}));
+      };
+    });
+  }
+
+  status(status) {
+    if (this.statusCb) this.statusCb(status);
+  }
+
+  login(user, password) {
+    return this.connect_promise.then(() => this.call([1, "login", [user, password]]));
+  }
+
+  get bufferedAmount() {
+    return this.ws ? this.ws.bufferedAmount : 0;
+  }
+
+  get writable() {
+    return this.bufferedAmount < this.highWaterMark;
+  }
+
+  // Calls fn once the socket buffer is back under the high-water mark.
+  onDrain(fn) {
+    if (this.writable) {
+      fn();
+      return;
+    }
+    this.drainWaiters.push(fn);
+    if (!this.drainTimer) this.pollDrain();
+  }
+
+  pollDrain() {
+    this.drainTimer = setTimeout(() => {
+      this.drainTimer = null;
+      if (!this.writable) {
+        this.pollDrain();
+        return;
+      }
+      let waiters = this.drainWaiters;
+      this.drainWaiters = [];
+      waiters.forEach(fn => fn());
+    }, 5);
+  }
+
+  template(api, method) {
+    let key = `${api}:${method}`;
+    let template = this.templates.get(key);
+    if (!template) {
+      template = `,"method":"call","params":[${JSON.stringify(api)},${JSON.stringify(method)},`;
+      this.templates.set(key, template);
+    }
+    return template;
+  }
+
+  call([api, method, params]) {
+    if (!this.ws || this.ws.readyState !== 1) {
+      return Promise.reject(new Error(`Connection to ${this.url} is not open`));
+    }
+    let id = this.nextId++;
+    if (this.nextId === 0x7fffffff) this.nextId = 1;
+    if (SUBSCRIBE[method]) {
+      params = this.subscribe(id, method, params);
+    } else if (method === "unsubscribe_from_market") {
+      if (typeof params[0] !== "function") {
+        return Promise.reject(new Error("First parameter of unsub must be the original callback"));
+      }
+      params = this.unsubscribe(params);
+    }
+
+    let text = `{"id":${id}${this.template(api, method)}${JSON.stringify(params)}]}`;
+    return new Promise((resolve, reject) => {
+      this.track(id, resolve, reject);
+      this.ws.send(text);
+    });
+  }
+
+  // Replaces the callback in params with the id the node will send notices under.
+  subscribe(id, method, params) {
+    let i = params.findIndex(p => typeof p === "function");
+    if (i === -1) return params;
+    let callback = params[i];
+    params = params.slice();
+    params[i] = id;
+    this.subs.set(id, {callback, key: method === "subscribe_to_market" ? JSON.stringify(params.slice(1)) : null});
+    return params;
+  }
+
+  // Takes the original callback first, as ChainWebSocket does, and returns the params to send.
+  unsubscribe(params) {
+    let callback = params[0];
+    let key = JSON.stringify(params.slice(1));
+    this.subs.forEach((sub, id) => {
+      if (sub.key === key && sub.callback === callback) this.subs.delete(id);
+    });
+    return params.slice(1);
+  }
+
+  track(id, resolve, reject) {
+    if (this.inflight * 2 >= this.size) this.grow();
+    let slot = id & (this.size - 1);
+    while (this.ids[slot] !== 0) slot = (slot + 1) & (this.size - 1);
+    this.ids[slot] = id;
+    this.resolves[slot] = resolve;
+    this.rejects[slot] = reject;
+    this.inflight++;
+  }
+
+  slotOf(id) {
+    let slot = id & (this.size - 1);
+    while (this.ids[slot] !== id) {
+      if (this.ids[slot] === 0) return -1;
+      slot = (slot + 1) & (this.size - 1);
+    }
+    return slot;
+  }
+
+  // Removes a slot keeping every other id reachable from its home slot (linear probing delete).
+  release(slot) {
+    let mask = this.size - 1;
+    this.ids[slot] = 0;
+    this.resolves[slot] = this.rejects[slot] = undefined;
+    this.inflight--;
+    let next = (slot + 1) & mask;
+    while (this.ids[next] !== 0) {
+      let id = this.ids[next];
+      let resolve = this.resolves[next];
+      let reject = this.rejects[next];
+      this.ids[next] = 0;
+      this.resolves[next] = this.rejects[next] = undefined;
+      this.inflight--;
+      this.track(id, resolve, reject);
+      next = (next + 1) & mask;
+    }
+  }
+
+  grow() {
+    let {ids, resolves, rejects} = this;
+    this.size *= 2;
+    this.ids = new Int32Array(this.size);
+    this.resolves = new Array(this.size);
+    this.rejects = new Array(this.size);
+    this.inflight = 0;
+    for (let i = 0; i < ids.length; i++) {
+      if (ids[i] !== 0) this.track(ids[i], resolves[i], rejects[i]);
+    }
+  }
+
+  count(name, n) {
+    if (this.metrics) this.metrics.count(name, n);
+  }
+
+  // Bytes off the wire since the last message, frame headers included, and payload bytes of the
+  // message. Only the node socket underneath ws exposes the former; browsers report payload alone.
+  measure(length) {
+    let socket = this.ws && this.ws._socket;
+    let wire = length;
+    if (socket && typeof socket.bytesRead === "number") {
+      wire = socket.bytesRead - this.bytesRead;
+      this.bytesRead = socket.bytesRead;
+    }
+    this.wireBytes += wire;
+    this.payloadBytes += length;
+    if (!this.metrics) return;
+    this.metrics.count("transport.rx.wire", wire);
+    this.metrics.count("transport.rx.payload", length);
+
+    // Inflating runs on the zlib threads, so CPU is sampled process-wide per MB of payload.
+    this.cpuBytes += length;
+    if (this.cpuBytes >= 1 << 20) {
+      let cpu = cpuTime();
+      this.metrics.timing(this.compressed ? "transport.cpu_per_mb.deflate" : "transport.cpu_per_mb.plain",
+        (cpu - this.cpuMark) / (this.cpuBytes / (1 << 20)));
+      this.cpuMark = cpu;
+      this.cpuBytes = 0;
+    }
+  }
+
+  stats() {
+    return {
+      compressed: this.compressed,
+      wireBytes: this.wireBytes,
+      payloadBytes: this.payloadBytes,
+      ratio: this.payloadBytes ? this.wireBytes / this.payloadBytes : 1,
+    };
+  }
+
+  receive(data) {
+    this.measure(byteLength(data));
+    let text = typeof data === "string" ? data : data.toString();
+    let start = this.metrics ? this.metrics.now() : 0;
+    let message = text.length > LARGE_MESSAGE ?
+      Monitor.track("JSONDecode", () => JSON.parse(text)) :
+      JSON.parse(text);
+    if (this.metrics) this.metrics.timing("transport.decode", this.metrics.now() - start);
+
+    if (message.method === "notice") {
+      let sub = this.subs.get(message.params[0]);
+      if (sub) sub.callback(message.params[1]);
+      return;
+    }
+    let slot = this.slotOf(message.id);
+    if (slot === -1) return;
+    let resolve = this.resolves[slot];
+    let reject = this.rejects[slot];
+    this.release(slot);
+    if (message.error) reject(Object.assign(new Error(message.error.message), {code: message.error.code, data: message.error.data, reply: true}));
+    else resolve(message.result);
+  }
+
+  failAll(error) {
+    for (let i = 0; i < this.size; i++) {
+      if (this.ids[i] !== 0) {
+        let reject = this.rejects[i];
+        this.ids[i] = 0;
+        this.resolves[i] = this.rejects[i] = undefined;
+        reject(error);
+      }
+    }
+    this.inflight = 0;
+  }
+
+  closed() {
+    this.ws = null;
+    this.failAll(closedError(this.url));
+    // Notice ids die with the socket, RpcApi subscribes again once the API sets are reopened.
+    this.subs.clear();
+    this.status("closed");
+    if (this.closing || !this.autoReconnect) return;
+
+    let delay = Math.min(30000, 500 * Math.pow(2, this.retries++));
+    this.reconnectTimer = setTimeout(() => {
+      this.reconnectTimer = null;
+      if (this.closing) return;
+      this.connect_promise = this.open();
+      this.connect_promise.then(() => {
+        if (this.on_reconnect) this.on_reconnect();
+      }, () => this.closed());
+    }, delay);
+    if (this.reconnectTimer.unref) this.reconnectTimer.unref();
+  }
+
+  close() {
+    this.closing = true;
+    clearTimeout(this.reconnectTimer);
+    this.reconnectTimer = null;
+    let ws = this.ws;
+    if (!ws) return Promise.resolve();
+    return new Promise(resolve => {
+      ws.onclose = () => {
+        this.ws = null;
+        this.failAll(closedError(this.url));
+        resolve();
+      };
+      ws.close();
+    });
+  }
+}
+
+/**
+ * An API set over an RpcSocket, the counterpart of GrapheneApi without its per-call wrappers. The
+ * node forgets subscriptions with the socket, so the ones made through this API set are sent again
+ * when init() runs after a reconnect.
+ */
+export class RpcApi {
+  constructor(socket, name) {
+    this.socket = socket;
+    this.api_name = name;
+    this.api_id = null;
+    this.subscriptions = new Map();
+  }
+
+  init() {
+    return this.socket.call([1, this.api_name, []]).then(id => {
+      let reconnected = this.api_id !== null;
+      this.api_id = id;
+      if (!reconnected) return this;
+      let replay = Array.from(this.subscriptions.values(), ([method, params]) =>
+        this.socket.call([id, method, params]).catch(() => null));
+      return Promise.all(replay).then(() => this);
+    });
+  }
+
+  exec(method, params) {
+    let key = replayKey(method, params);
+    if (key) {
+      this.subscriptions.set(key, [method, params]);
+    } else if (method === "unsubscribe_from_market") {
+      this.subscriptions.delete(`market:${JSON.stringify(params.slice(1))}`);
+    } else if (method === "cancel_all_subscriptions") {
+      this.subscriptions.clear();
+    }
+    return this.socket.call([this.api_id, method, params]);
+  }
+}
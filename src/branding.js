@@ -86,103 +86,7 @@ export function getMyMarketsBases() {
  * @returns {[string]}
  */
 export function getMyMarketsQuotes() {
-    let tokens = {
-        nativeTokens: [
-            "BTC",
-            "BTS",
-            "CNY",
-            "EUR",
-            "GOLD",
-            "KRW",
-            "RUBLE",
-            "SILVER",
-            "USD"
-        ],
-        bridgeTokens: ["BRIDGE.BCO", "BRIDGE.BTC", "BRIDGE.MONA", "BRIDGE.ZNY"],
-        gdexTokens: ["GDEX.BTC", "GDEX.BTO", "GDEX.EOS", "GDEX.ETH"],
-        openledgerTokens: [
-            "OBITS",
-            "OPEN.BTC",
-            "OPEN.DASH",
-            "OPEN.DGD",
-            "OPEN.DOGE",
-            "OPEN.EOS",
-            "OPEN.EOSDAC",
-            "OPEN.ETH",
-            "OPEN.EURT",
-            "OPEN.GAME",
-            "OPEN.GRC",
-            "OPEN.INCNT",
-            "OPEN.KRM",
-            "OPEN.LISK",
-            "OPEN.LTC",
-            "OPEN.MAID",
-            "OPEN.MKR",
-            "OPEN.NEO",
-            "OPEN.OMG",
-            "OPEN.SBD",
-            "OPEN.STEEM",
-            "OPEN.TUSD",
-            "OPEN.USDT",
-            "OPEN.WAVES",
-            "OPEN.XMR",
-            "OPEN.ZEC",
-            "OPEN.ZRX"
-        ],
-        rudexTokens: [
-            "PPY",
-            "RUDEX.DCT",
-            "RUDEX.DGB",
-            "RUDEX.GBG",
-            "RUDEX.GOLOS",
-            "RUDEX.KRM",
-            "RUDEX.MUSE",
-            "RUDEX.SBD",
-            "RUDEX.STEEM",
-            "RUDEX.TT"
-        ],
-        sparkTokens: ["ZEPH", "SPARKDEX.ETH", "SPARKDEX.BTC"],
-        winTokens: ["WIN.ETC", "WIN.ETH", "WIN.HSR"],
-        xbtsxTokens: [
-            "XBTSX.STH",
-            "XBTSX.POST",
-            "XBTSX.DOGE",
-            "XBTSX.BTC",
-            "XBTSX.LTC",
-            "XBTSX.DASH",
-            "XBTSX.KEC",
-            "XBTSX.BCH",
-            "XBTSX.BTG",
-            "XBTSX.XSPEC",
-            "XBTSX.NVC"
-        ],
-        otherTokens: [
-            "BKT",
-            "BLOCKPAY",
-            "BTWTY",
-            "TWENTIX",
-            "BTSR",
-            "CADASTRAL",
-            "CVCOIN",
-            "HEMPSWEET",
-            "HERO",
-            "HERTZ",
-            "ICOO",
-            "IOU.CNY",
-            "KAPITAL",
-            "KEXCOIN",
-            "OCT",
-            "SMOKE",
-            "STEALTH",
-            "YOYOW"
-        ]
-    };
-
-    let allTokens = [];
-    for (let type in tokens) {
-        allTokens = allTokens.concat(tokens[type]);
-    }
-    return allTokens;
+    return registry.myMarketsQuotes;
 }
 
 /**
@@ -191,87 +95,47 @@ export function getMyMarketsQuotes() {
  * @returns {list of string tuples}
  */
 export function getFeaturedMarkets(quotes = []) {
-    return [
-        ["USD", "BTS"],
-        ["USD", "OPEN.BTC"],
-        ["USD", "OPEN.USDT"],
-        ["USD", "OPEN.ETH"],
-        ["USD", "OPEN.DASH"],
-        ["USD", "GOLD"],
-        ["USD", "HERO"],
-        ["USD", "GDEX.BTC"],
-        ["USD", "GDEX.ETH"],
-        ["USD", "GDEX.EOS"],
-        ["USD", "GDEX.BTO"],
-        ["USD", "OPEN.EOSDAC"],
-        ["CNY", "BTS"],
-        ["CNY", "OPEN.BTC"],
-        ["CNY", "USD"],
-        ["CNY", "OPEN.ETH"],
-        ["CNY", "YOYOW"],
-        ["CNY", "OCT"],
-        ["CNY", "GDEX.BTC"],
-        ["CNY", "GDEX.ETH"],
-        ["CNY", "GDEX.EOS"],
-        ["CNY", "GDEX.BTO"],
-        ["CNY", "GDEX.BTM"],
-        ["OPEN.BTC", "BTS"],
-        ["OPEN.BTC", "OPEN.ETH"],
-        ["OPEN.BTC", "OPEN.DASH"],
-        ["OPEN.BTC", "BLOCKPAY"],
-        ["OPEN.BTC", "OPEN.DGD"],
-        ["OPEN.BTC", "OPEN.STEEM"],
-        ["BTS", "OPEN.ETH"],
-        ["BTS", "OPEN.EOS"],
-        ["BTS", "PPY"],
-        ["BTS", "OPEN.STEEM"],
-        ["BTS", "OBITS"],
-        ["BTS", "RUBLE"],
-        ["BTS", "HERO"],
-        ["BTS", "OCT"],
-        ["BTS", "SILVER"],
-        ["BTS", "GOLD"],
-        ["BTS", "BLOCKPAY"],
-        ["BTS", "BTWTY"],
-        ["BTS", "SMOKE"],
-        ["BTS", "GDEX.BTC"],
-        ["BTS", "GDEX.ETH"],
-        ["BTS", "GDEX.EOS"],
-        ["BTS", "GDEX.BTO"],
-        ["BTS", "OPEN.EOSDAC"],
-        ["KAPITAL", "OPEN.BTC"],
-        ["USD", "OPEN.STEEM"],
-        ["USD", "OPEN.MAID"],
-        ["OPEN.USDT", "OPEN.BTC"],
-        ["OPEN.BTC", "OPEN.MAID"],
-        ["BTS", "OPEN.MAID"],
-        ["BTS", "OPEN.HEAT"],
-        ["BTS", "OPEN.INCENT"],
-        ["HEMPSWEET", "OPEN.BTC"],
-        ["KAPITAL", "BTS"],
-        ["BTS", "RUDEX.STEEM"],
-        ["USD", "RUDEX.STEEM"],
-        ["BTS", "RUDEX.SBD"],
-        ["BTS", "RUDEX.KRM"],
-        ["USD", "RUDEX.KRM"],
-        ["RUBLE", "RUDEX.GOLOS"],
-        ["CNY", "RUDEX.GOLOS"],
-        ["RUBLE", "RUDEX.GBG"],
-        ["CNY", "RUDEX.GBG"],
-        ["BTS", "RUDEX.MUSE"],
-        ["BTS", "RUDEX.TT"],
-        ["BTS", "RUDEX.SCR"],
-        ["BTS", "RUDEX.ETH"],
-        ["BTS", "RUDEX.DGB"],
-        ["BTS", "XBTSX.STH"],
-        ["BTS", "ZEPH"],
-        ["BTS", "HERTZ"],
-        ["BTS", "SPARKDEX.BTC"],
-        ["BTS", "SPARKDEX.ETH"]
-    ].filter(a => {
-        if (!quotes.length) return true;
-        return quotes.indexOf(a[0]) !== -1;
-    });
+    if (!quotes.length) return featured.all;
+
+    let key = Array.from(new Set(quotes)).sort().join(",");
+    let cached = featured.memo.get(key);
+    if (cached) return cached;
+
+    let wanted = new Set(quotes);
+    let result = Object.freeze(featured.all.filter(a => wanted.has(a[0])));
+    if (featured.memo.size >= featured.memoLimit) featured.memo.clear();
+    featured.memo.set(key, result);
+    return result;
+}
+
+/**
+ * Featured markets that include the asset on either side
+ *
+ * @param symbol
+ * @returns {list of string tuples}
+ */
+export function getFeaturedMarketsByAsset(symbol) {
+    return featured.byAsset.get(symbol) || featured.none;
+}
+
+/**
+ * Featured markets with the given base (first element), the side getFeaturedMarkets(quotes) filters on
+ *
+ * @param symbol
+ * @returns {list of string tuples}
+ */
+export function getFeaturedMarketsByBase(symbol) {
+    return featured.byBase.get(symbol) || featured.none;
+}
+
+/**
+ * Featured markets with the given quote (second element)
+ *
+ * @param symbol
+ * @returns {list of string tuples}
+ */
+export function getFeaturedMarketsByQuote(symbol) {
+    return featured.byQuote.get(symbol) || featured.none;
 }
 
 /**
@@ -280,16 +144,31 @@ export function getFeaturedMarkets(quotes = []) {
  * @returns {[string,string,string,string,string,string,string]}
  */
 export function getAssetNamespaces() {
-    return [
-        "OPEN.",
-        "RUDEX.",
-        "WIN.",
-        "BRIDGE.",
-        "GDEX.",
-        "XBTSX.",
-        "SPARKDEX.",
-        "CITADEL."
-    ];
+    return registry.namespaces;
+}
+
+/**
+ * Recognized namespace of an asset symbol, e.g. "OPEN." for "OPEN.BTC"
+ *
+ * @param symbol
+ * @returns {string|null}
+ */
+export function getAssetNamespace(symbol) {
+    let known = registry.symbolNamespace.get(symbol);
+    if (known !== undefined) return known;
+    return matchPrefix(registry.namespaceTrie, symbol);
+}
+
+/**
+ * Allowed gateway that issues an asset symbol, e.g. "OPEN" for "OPEN.BTC"
+ *
+ * @param symbol
+ * @returns {string|null}
+ */
+export function getAssetGateway(symbol) {
+    let known = registry.symbolGateway.get(symbol);
+    if (known !== undefined) return known;
+    return namespaceGateway(getAssetNamespace(symbol));
 }
 
 /**
@@ -307,18 +186,7 @@ export function getAssetHideNamespaces() {
  * @returns {boolean}
  */
 export function allowedGateway(gateway) {
-    return (
-        [
-            "OPEN",
-            "RUDEX",
-            "WIN",
-            "BRIDGE",
-            "GDEX",
-            "XBTSX",
-            "SPARKDEX",
-            "CITADEL"
-        ].indexOf(gateway) >= 0
-    );
+    return registry.gateways.has(gateway);
 }
 
 export function getSupportedLanguages() {
@@ -329,3 +197,287 @@ export function getAllowedLogins() {
     // possible: list containing any combination of ["password", "wallet"]
     return ["password", "wallet"];
 }
+
+const myMarketsTokens = {
+    nativeTokens: [
+        "BTC",
+        "BTS",
+        "CNY",
+        "EUR",
+        "GOLD",
+        "KRW",
+        "RUBLE",
+        "SILVER",
+        "USD"
+    ],
+    bridgeTokens: ["BRIDGE.BCO", "BRIDGE.BTC", "BRIDGE.MONA", "BRIDGE.ZNY"],
+    gdexTokens: ["GDEX.BTC", "GDEX.BTO", "GDEX.EOS", "GDEX.ETH"],
+    openledgerTokens: [
+        "OBITS",
+        "OPEN.BTC",
+        "OPEN.DASH",
+        "OPEN.DGD",
+        "OPEN.DOGE",
+        "OPEN.EOS",
+        "OPEN.EOSDAC",
+        "OPEN.ETH",
+        "OPEN.EURT",
+        "OPEN.GAME",
+        "OPEN.GRC",
+        "OPEN.INCNT",
+        "OPEN.KRM",
+        "OPEN.LISK",
+        "OPEN.LTC",
+        "OPEN.MAID",
+        "OPEN.MKR",
+        "OPEN.NEO",
+        "OPEN.OMG",
+        "OPEN.SBD",
+        "OPEN.STEEM",
+        "OPEN.TUSD",
+        "OPEN.USDT",
+        "OPEN.WAVES",
+        "OPEN.XMR",
+        "OPEN.ZEC",
+        "OPEN.ZRX"
+    ],
+    rudexTokens: [
+        "PPY",
+        "RUDEX.DCT",
+        "RUDEX.DGB",
+        "RUDEX.GBG",
+        "RUDEX.GOLOS",
+        "RUDEX.KRM",
+        "RUDEX.MUSE",
+        "RUDEX.SBD",
+        "RUDEX.STEEM",
+        "RUDEX.TT"
+    ],
+    sparkTokens: ["ZEPH", "SPARKDEX.ETH", "SPARKDEX.BTC"],
+    winTokens: ["WIN.ETC", "WIN.ETH", "WIN.HSR"],
+    xbtsxTokens: [
+        "XBTSX.STH",
+        "XBTSX.POST",
+        "XBTSX.DOGE",
+        "XBTSX.BTC",
+        "XBTSX.LTC",
+        "XBTSX.DASH",
+        "XBTSX.KEC",
+        "XBTSX.BCH",
+        "XBTSX.BTG",
+        "XBTSX.XSPEC",
+        "XBTSX.NVC"
+    ],
+    otherTokens: [
+        "BKT",
+        "BLOCKPAY",
+        "BTWTY",
+        "TWENTIX",
+        "BTSR",
+        "CADASTRAL",
+        "CVCOIN",
+        "HEMPSWEET",
+        "HERO",
+        "HERTZ",
+        "ICOO",
+        "IOU.CNY",
+        "KAPITAL",
+        "KEXCOIN",
+        "OCT",
+        "SMOKE",
+        "STEALTH",
+        "YOYOW"
+    ]
+};
+
+const assetNamespaces = [
+    "OPEN.",
+    "RUDEX.",
+    "WIN.",
+    "BRIDGE.",
+    "GDEX.",
+    "XBTSX.",
+    "SPARKDEX.",
+    "CITADEL."
+];
+
+const gateways = [
+    "OPEN",
+    "RUDEX",
+    "WIN",
+    "BRIDGE",
+    "GDEX",
+    "XBTSX",
+    "SPARKDEX",
+    "CITADEL"
+];
+
+/**
+ * Character trie over the namespaces, resolves the longest namespace a symbol starts with
+ * in O(symbol length) instead of scanning every namespace
+ */
+function buildPrefixTrie(prefixes) {
+    let root = new Map();
+    prefixes.forEach(prefix => {
+        let node = root;
+        for (let ch of prefix) {
+            if (!node.has(ch)) node.set(ch, new Map());
+            node = node.get(ch);
+        }
+        node.set("", prefix);
+    });
+    return root;
+}
+
+function matchPrefix(trie, symbol) {
+    let node = trie;
+    let match = null;
+    for (let i = 0; symbol && i < symbol.length; i++) {
+        node = node.get(symbol[i]);
+        if (!node) break;
+        if (node.has("")) match = node.get("");
+    }
+    return match;
+}
+
+function namespaceGateway(namespace) {
+    if (!namespace) return null;
+    let gateway = namespace.slice(0, -1);
+    return registry.gateways.has(gateway) ? gateway : null;
+}
+
+/**
+ * Lookup tables built once at module load, the exported getters only read from here
+ */
+const registry = (() => {
+    let myMarketsQuotes = [];
+    for (let type in myMarketsTokens) {
+        myMarketsQuotes = myMarketsQuotes.concat(myMarketsTokens[type]);
+    }
+    return {
+        myMarketsQuotes: Object.freeze(myMarketsQuotes),
+        namespaces: Object.freeze(assetNamespaces.slice()),
+        namespaceTrie: buildPrefixTrie(assetNamespaces),
+        gateways: new Set(gateways),
+        symbolNamespace: new Map(),
+        symbolGateway: new Map()
+    };
+})();
+
+registry.myMarketsQuotes.forEach(symbol => {
+    let namespace = matchPrefix(registry.namespaceTrie, symbol);
+    registry.symbolNamespace.set(symbol, namespace);
+    registry.symbolGateway.set(symbol, namespaceGateway(namespace));
+});
+
+const featuredMarkets = [
+    ["USD", "BTS"],
+    ["USD", "OPEN.BTC"],
+    ["USD", "OPEN.USDT"],
+    ["USD", "OPEN.ETH"],
+    ["USD", "OPEN.DASH"],
+    ["USD", "GOLD"],
+    ["USD", "HERO"],
+    ["USD", "GDEX.BTC"],
+    ["USD", "GDEX.ETH"],
+    ["USD", "GDEX.EOS"],
+    ["USD", "GDEX.BTO"],
+    ["USD", "OPEN.EOSDAC"],
+    ["CNY", "BTS"],
+    ["CNY", "OPEN.BTC"],
+    ["CNY", "USD"],
+    ["CNY", "OPEN.ETH"],
+    ["CNY", "YOYOW"],
+    ["CNY", "OCT"],
+    ["CNY", "GDEX.BTC"],
+    ["CNY", "GDEX.ETH"],
+    ["CNY", "GDEX.EOS"],
+    ["CNY", "GDEX.BTO"],
+    ["CNY", "GDEX.BTM"],
+    ["OPEN.BTC", "BTS"],
+    ["OPEN.BTC", "OPEN.ETH"],
+    ["OPEN.BTC", "OPEN.DASH"],
+    ["OPEN.BTC", "BLOCKPAY"],
+    ["OPEN.BTC", "OPEN.DGD"],
+    ["OPEN.BTC", "OPEN.STEEM"],
+    ["BTS", "OPEN.ETH"],
+    ["BTS", "OPEN.EOS"],
+    ["BTS", "PPY"],
+    ["BTS", "OPEN.STEEM"],
+    ["BTS", "OBITS"],
+    ["BTS", "RUBLE"],
+    ["BTS", "HERO"],
+    ["BTS", "OCT"],
+    ["BTS", "SILVER"],
+    ["BTS", "GOLD"],
+    ["BTS", "BLOCKPAY"],
+    ["BTS", "BTWTY"],
+    ["BTS", "SMOKE"],
+    ["BTS", "GDEX.BTC"],
+    ["BTS", "GDEX.ETH"],
+    ["BTS", "GDEX.EOS"],
+    ["BTS", "GDEX.BTO"],
+    ["BTS", "OPEN.EOSDAC"],
+    ["KAPITAL", "OPEN.BTC"],
+    ["USD", "OPEN.STEEM"],
+    ["USD", "OPEN.MAID"],
+    ["OPEN.USDT", "OPEN.BTC"],
+    ["OPEN.BTC", "OPEN.MAID"],
+    ["BTS", "OPEN.MAID"],
+    ["BTS", "OPEN.HEAT"],
+    ["BTS", "OPEN.INCENT"],
+    ["HEMPSWEET", "OPEN.BTC"],
+    ["KAPITAL", "BTS"],
+    ["BTS", "RUDEX.STEEM"],
+    ["USD", "RUDEX.STEEM"],
+    ["BTS", "RUDEX.SBD"],
+    ["BTS", "RUDEX.KRM"],
+    ["USD", "RUDEX.KRM"],
+    ["RUBLE", "RUDEX.GOLOS"],
+    ["CNY", "RUDEX.GOLOS"],
+    ["RUBLE", "RUDEX.GBG"],
+    ["CNY", "RUDEX.GBG"],
+    ["BTS", "RUDEX.MUSE"],
+    ["BTS", "RUDEX.TT"],
+    ["BTS", "RUDEX.SCR"],
+    ["BTS", "RUDEX.ETH"],
+    ["BTS", "RUDEX.DGB"],
+    ["BTS", "XBTSX.STH"],
+    ["BTS", "ZEPH"],
+    ["BTS", "HERTZ"],
+    ["BTS", "SPARKDEX.BTC"],
+    ["BTS", "SPARKDEX.ETH"]
+];
+
+/**
+ * Featured markets with indexes by each side, results of filtered queries are memoized per
+ * normalized (deduped, sorted) quote set
+ */
+const featured = (() => {
+    let all = Object.freeze(featuredMarkets.map(pair => Object.freeze(pair)));
+    let byBase = new Map();
+    let byQuote = new Map();
+    let byAsset = new Map();
+    let add = (index, symbol, pair) => {
+        if (!index.has(symbol)) index.set(symbol, []);
+        index.get(symbol).push(pair);
+    };
+    all.forEach(pair => {
+        add(byBase, pair[0], pair);
+        add(byQuote, pair[1], pair);
+        add(byAsset, pair[0], pair);
+        if (pair[1] !== pair[0]) add(byAsset, pair[1], pair);
+    });
+    [byBase, byQuote, byAsset].forEach(index =>
+        index.forEach(list => Object.freeze(list))
+    );
+    return {
+        all,
+        byBase,
+        byQuote,
+        byAsset,
+        none: Object.freeze([]),
+        memo: new Map(),
+        memoLimit: 256
+    };
+})();
@@ -0,0 +1,261 @@
+import {BitShares} from "../api/bitshares";
+import {getFeaturedMarkets} from "../branding";
+
+const BLOCK_SIZE = 64;
+
+/**
+ * Price levels of one side of a book, kept sorted in blocks of at most 2 * BLOCK_SIZE prices.
+ * Finding a block and a slot in it are binary searches and a splice only moves one small block,
+ * so updates are O(log n) while scans stay sequential. Best price is the head of the first block.
+ */
+export class PriceLevels {
+  constructor(descending = false) {
+    this.sign = descending ? -1 : 1;
+    this.blocks = [];
+    this.levels = new Map();
+  }
+
+  get size() {
+    return this.levels.size;
+  }
+
+  // Index of the first block whose last price does not sort before `price`.
+  findBlock(price) {
+    let lo = 0;
+    let hi = this.blocks.length - 1;
+    while (lo < hi) {
+      let mid = (lo + hi) >> 1;
+      let block = this.blocks[mid];
+      if (this.sign * (block[block.length - 1] - price) < 0) lo = mid + 1;
+      else hi = mid;
+    }
+    return lo;
+  }
+
+  findSlot(block, price) {
+    let lo = 0;
+    let hi = block.length;
+    while (lo < hi) {
+      let mid = (lo + hi) >> 1;
+      if (this.sign * (block[mid] - price) < 0) lo = mid + 1;
+      else hi = mid;
+    }
+    return lo;
+  }
+
+  // Adds `amount` and `orders` to the level at `price`. A level is dropped once it holds no orders,
+  // so rounding left over in the amount never keeps an empty level alive.
+  add(price, amount, orders = 1) {
+    let level = this.levels.get(price);
+    if (level) {
+      level.amount += amount;
+      level.orders += orders;
+      if (level.orders <= 0) this.remove(price);
+      return;
+    }
+    if (orders <= 0) return;
+
+    this.levels.set(price, {price, amount, orders});
+    if (!this.blocks.length) {
+      this.blocks.push([price]);
+      return;
+    }
+    let b = this.findBlock(price);
+    let block = this.blocks[b];
+    block.splice(this.findSlot(block, price), 0, price);
+    if (block.length > 2 * BLOCK_SIZE) {
+      this.blocks.splice(b + 1, 0, block.splice(BLOCK_SIZE));
+    }
+  }
+
+  remove(price) {
+    if (!this.levels.delete(price)) return;
+    let b = this.findBlock(price);
+    let block = this.blocks[b];
+    block.splice(this.findSlot(block, price), 1);
+    if (!block.length) this.blocks.splice(b, 1);
+  }
+
+  best() {
+    return this.blocks.length ? this.levels.get(this.blocks[0][0]) : null;
+  }
+
+  top(count = Infinity) {
+    let res = [];
+    for (let b = 0; b < this.blocks.length && res.length < count; b++) {
+      let block = this.blocks[b];
+      for (let i = 0; i < block.length && res.length < count; i++) {
+        res.push(this.levels.get(block[i]));
+      }
+    }
+    return res;
+  }
+
+  clear() {
+    this.blocks = [];
+    this.levels.clear();
+  }
+}
+
+/**
+ * Order book of one market built from a get_limit_orders snapshot and kept current with
+ * subscribe_to_market deltas. Prices are in base per quote, amounts in quote units.
+ */
+export class OrderBook {
+  constructor(base, quote, {client = BitShares, limit = 300, onUpdate = null} = {}) {
+    this.client = client;
+    this.base = base;
+    this.quote = quote;
+    this.limit = limit;
+    this.onUpdate = onUpdate;
+    this.bids = new PriceLevels(true);
+    this.asks = new PriceLevels(false);
+    this.orders = new Map();
+    this.pending = null;
+    this.assets = null;
+    this.onNotice = this.onNotice.bind(this);
+  }
+
+  async start() {
+    let [base, quote] = await this.client.assets.resolve([this.base, this.quote]);
+    if (!base || !quote) {
+      throw new Error(`Unknown market ${this.quote}_${this.base}`);
+    }
+    this.assets = {base, quote};
+
+    // Deltas arriving while the snapshot loads are held back and replayed on top of it. If the
+    // snapshot fails the subscription is dropped again, nobody would be left to stop it; the
+    // snapshot error is the one thrown.
+    this.pending = [];
+    let db = this.client.api().DB;
+    let orders;
+    try {
+      await db.SubscribeMarket(this.onNotice, base.id, quote.id);
+      orders = await this.client.metricsRegistry.timeAsync("orderbook.snapshot", () => db.LimitOrders(base.id, quote.id, this.limit));
+    } catch (e) {
+      await db.UnsubscribeMarket(this.onNotice, base.id, quote.id)
+        .catch(() => this.client.metricsRegistry.count("orderbook.error"));
+      this.pending = null;
+      this.assets = null;
+      throw e;
+    }
+
+    this.reset();
+    orders.forEach(order => this.upsert(order));
+    let pending = this.pending;
+    this.pending = null;
+    pending.forEach(update => this.apply(update));
+    this.notify();
+    return this;
+  }
+
+  // Notices keep applying until the node dropped the subscription; a failed unsubscribe leaves the
+  // book running so stop() can be retried.
+  async stop() {
+    if (!this.assets) return;
+    let {base, quote} = this.assets;
+    await this.client.api().DB.UnsubscribeMarket(this.onNotice, base.id, quote.id);
+    this.assets = null;
+  }
+
+  reset() {
+    this.bids.clear();
+    this.asks.clear();
+    this.orders.clear();
+  }
+
+  // Notices still in flight when the book stopped are dropped.
+  onNotice(updates) {
+    if (!this.assets) return;
+    if (this.pending) {
+      this.pending.push(updates);
+      return;
+    }
+    this.apply(updates);
+    this.notify();
+  }
+
+  // Notices carry removed order ids, new or changed limit orders and fill operations. Anything
+  // that is not a limit order of this market is skipped.
+  apply(update) {
+    if (!this.assets) return;
+    if (Array.isArray(update)) {
+      update.forEach(item => this.apply(item));
+    } else if (typeof update === "string") {
+      this.removeOrder(update);
+    } else if (update && update.sell_price && update.for_sale !== undefined) {
+      this.upsert(update);
+    }
+  }
+
+  upsert(order) {
+    let {base, quote} = this.assets;
+    let sellBase = order.sell_price.base;
+    let sellQuote = order.sell_price.quote;
+    let entry;
+
+    if (sellBase.asset_id === base.id && sellQuote.asset_id === quote.id) {
+      let price = this.price(sellBase.amount, sellQuote.amount);
+      let amount = (order.for_sale * sellQuote.amount) / sellBase.amount / Math.pow(10, quote.precision);
+      entry = {side: this.bids, price, amount};
+    } else if (sellBase.asset_id === quote.id && sellQuote.asset_id === base.id) {
+      let price = this.price(sellQuote.amount, sellBase.amount);
+      let amount = order.for_sale / Math.pow(10, quote.precision);
+      entry = {side: this.asks, price, amount};
+    } else {
+      return;
+    }
+
+    this.removeOrder(order.id);
+    this.orders.set(order.id, entry);
+    entry.side.add(entry.price, entry.amount, 1);
+  }
+
+  removeOrder(id) {
+    let entry = this.orders.get(id);
+    if (!entry) return;
+    this.orders.delete(id);
+    entry.side.add(entry.price, -entry.amount, -1);
+  }
+
+  // Single division of exact integers, so equal ratios always land on the same level key.
+  price(baseAmount, quoteAmount) {
+    let {base, quote} = this.assets;
+    let scale = quote.precision - base.precision;
+    return scale >= 0 ?
+      (baseAmount * Math.pow(10, scale)) / quoteAmount :
+      baseAmount / (quoteAmount * Math.pow(10, -scale));
+  }
+
+  notify() {
+    if (this.onUpdate) this.onUpdate(this);
+  }
+
+  bestBid() {
+    return this.bids.best();
+  }
+
+  bestAsk() {
+    return this.asks.best();
+  }
+
+  depth(levels = 50) {
+    return {
+      bids: this.bids.top(levels),
+      asks: this.asks.top(levels),
+    };
+  }
+}
+
+export const OrderBooks = {
+  // Starts a book for every featured market, keyed by QUOTE_BASE. Markets that fail to start are left out.
+  featured: async (options = {}) => {
+    let client = options.client || BitShares;
+    let books = new Map();
+    await Promise.all(getFeaturedMarkets().map(([base, quote]) => {
+      let book = new OrderBook(base, quote, options);
+      return book.start().then(() => books.set(`${quote}_${base}`, book), () => client.metricsRegistry.count("orderbook.error"));
+    }));
+    return books;
+  },
+};
@@ -0,0 +1,126 @@
+import {BitShares} from "../api/bitshares";
+import {Priority} from "../api/scheduler";
+import {getFeaturedMarkets} from "../branding";
+import {LruCache} from "../utils/cache";
+
+const marketKey = (base, quote) => `${quote}_${base}`;
+
+// Map whose contents cannot change, so a snapshot handed out stays what it was when taken.
+const frozenMap = (entries) => {
+  let map = new Map(entries);
+  map.set = map.delete = map.clear = () => {
+    throw new TypeError("Ticker snapshots are read-only");
+  };
+  return Object.freeze(map);
+};
+
+// Keeps up to `limit` calls in flight: the socket sees a steady pipeline of requests instead of
+// one call per round trip or every market at once.
+const pipelined = async (tasks, limit) => {
+  let results = new Array(tasks.length);
+  let next = 0;
+  let worker = async () => {
+    while (next < tasks.length) {
+      let i = next++;
+      results[i] = await tasks[i]().then(value => ({value}), error => ({error}));
+    }
+  };
+  let workers = [];
+  for (let i = 0; i < Math.min(limit, tasks.length); i++) workers.push(worker());
+  await Promise.all(workers);
+  return results;
+};
+
+/**
+ * Ticker and 24h volume snapshots of a set of markets, featured markets by default. Entries live in
+ * a cache of `budget` bytes updated by each refresh, which then publishes a frozen copy of it as the
+ * new snapshot; under memory pressure a market may be missing until the next one.
+ */
+export class TickerService {
+  constructor({client = BitShares, interval = 30000, pipeline = 32, markets = null, budget = 8 * 1024 * 1024} = {}) {
+    this.client = client;
+    this.interval = interval;
+    this.pipeline = pipeline;
+    this.markets = markets;
+    this.cache = new LruCache({name: "tickers", budget});
+    this.timer = null;
+    this.current = null;
+    this.refreshing = null;
+  }
+
+  // Refreshes every `interval` ms in the background. Without start() snapshots are still served,
+  // and revalidated on read once older than `interval`.
+  start({interval = this.interval, pipeline = this.pipeline, markets = this.markets} = {}) {
+    this.stop();
+    Object.assign(this, {interval, pipeline, markets});
+    this.timer = setInterval(() => this.refresh().catch(() => this.client.metricsRegistry.count("tickers.error")), interval);
+    if (this.timer.unref) this.timer.unref();
+    return this.refresh();
+  }
+
+  stop() {
+    if (this.timer) clearInterval(this.timer);
+    this.timer = null;
+  }
+
+  // Stale-while-revalidate: a stale snapshot is returned at once while a refresh runs behind it,
+  // only the very first call waits for the network.
+  async snapshot() {
+    let snap = this.current;
+    if (!snap) return await this.refresh();
+    if (Date.now() - snap.updated > this.interval) {
+      this.refresh().catch(() => this.client.metricsRegistry.count("tickers.error"));
+    }
+    return snap;
+  }
+
+  async get(base, quote) {
+    let snap = await this.snapshot();
+    return snap.markets.get(marketKey(base, quote)) || null;
+  }
+
+  // Async so a client that is not connected rejects instead of throwing inside the timer.
+  async refresh() {
+    if (this.refreshing) return this.refreshing;
+
+    let metrics = this.client.metricsRegistry;
+    let markets = this.markets || getFeaturedMarkets();
+    let db = this.client.api().DB;
+    let options = {priority: Priority.BACKGROUND};
+    let tasks = [];
+    markets.forEach(([base, quote]) => {
+      tasks.push(() => db.Ticker(base, quote, options));
+      tasks.push(() => db.Volume24(base, quote, options));
+    });
+
+    this.refreshing = metrics.timeAsync("tickers.refresh", () => pipelined(tasks, this.pipeline)).then(results => {
+      let keys = new Set();
+      markets.forEach(([base, quote], i) => {
+        let key = marketKey(base, quote);
+        let ticker = results[2 * i];
+        let volume = results[2 * i + 1];
+        let old = this.cache.peek(key);
+        if (ticker.error || volume.error) metrics.count("tickers.error");
+        keys.add(key);
+        this.cache.set(key, Object.freeze({
+          base,
+          quote,
+          ticker: ticker.error ? (old ? old.ticker : null) : ticker.value,
+          volume: volume.error ? (old ? old.volume : null) : volume.value,
+        }));
+      });
+      Array.from(this.cache.keys()).forEach(key => {
+        if (!keys.has(key)) this.cache.delete(key);
+      });
+      let entries = [];
+      this.cache.forEach((entry, key) => entries.push([key, entry]));
+      this.current = Object.freeze({updated: Date.now(), markets: frozenMap(entries)});
+      return this.current;
+    }).finally(() => {
+      this.refreshing = null;
+    });
+    return this.refreshing;
+  }
+}
+
+export const Tickers = new TickerService();
@@ -0,0 +1,227 @@
+// Rough heap cost of a value in bytes, good enough to compare caches and plan capacity. Shared
+// references are counted every time they are reached.
+export const sizeOf = (value, depth = 0) => {
+  switch (typeof value) {
+    case "string":
+      return 16 + 2 * value.length;
+    case "number":
+    case "boolean":
+    case "undefined":
+      return 8;
+    case "object":
+      break;
+    default:
+      return 16;
+  }
+  if (value === null) return 8;
+  if (ArrayBuffer.isView(value)) return 64 + value.byteLength;
+  if (depth > 8) return 64;
+  let size = 32;
+  if (Array.isArray(value)) {
+    for (let i = 0; i < value.length; i++) size += 8 + sizeOf(value[i], depth + 1);
+    return size;
+  }
+  if (value instanceof Map) {
+    value.forEach((v, k) => {
+      size += 32 + sizeOf(k, depth + 1) + sizeOf(v, depth + 1);
+    });
+    return size;
+  }
+  for (let key in value) {
+    if (Object.prototype.hasOwnProperty.call(value, key)) size += 16 + sizeOf(value[key], depth + 1);
+  }
+  return size;
+};
+
+const weakRef = (target) => (typeof WeakRef !== "undefined" ? new WeakRef(target) : {deref: () => target});
+
+/**
+ * Byte budget shared by every LruCache registered with it. When the total goes over `limit` the
+ * least recently used entry over all caches is evicted, wherever it lives. Caches are held weakly
+ * where the runtime allows, a dropped client takes its bytes with it.
+ */
+export class MemoryBudget {
+  constructor(limit = 256 * 1024 * 1024) {
+    this.limit = limit;
+    this.used = 0;
+    this.tick = 0;
+    this.members = new Set();
+  }
+
+  configure({limit = this.limit} = {}) {
+    this.limit = limit;
+    this.trim();
+  }
+
+  register(cache) {
+    if (cache.member) return;
+    cache.member = {ref: weakRef(cache), account: cache.account};
+    this.members.add(cache.member);
+  }
+
+  unregister(cache) {
+    if (!cache.member) return;
+    this.members.delete(cache.member);
+    cache.member = null;
+  }
+
+  trim() {
+    while (this.used > this.limit) {
+      let oldest = null;
+      let oldestTick = Infinity;
+      this.members.forEach(member => {
+        let cache = member.ref.deref();
+        if (!cache) {
+          this.used -= member.account.bytes;
+          this.members.delete(member);
+          return;
+        }
+        let tick = cache.oldestTick();
+        if (tick < oldestTick) {
+          oldest = cache;
+          oldestTick = tick;
+        }
+      });
+      if (!oldest) return;
+      oldest.evictOldest();
+    }
+  }
+
+  stats() {
+    let caches = [];
+    this.members.forEach(member => {
+      let cache = member.ref.deref();
+      if (cache) caches.push(cache.stats());
+    });
+    return {limit: this.limit, used: this.used, caches};
+  }
+}
+
+// Process-wide budget all caches of the library share unless given their own.
+export const Memory = new MemoryBudget();
+
+/**
+ * Map-like cache evicting least recently used entries once its entries take more than `budget`
+ * bytes or the shared MemoryBudget runs out. Entry sizes come from `sizeOf` unless set() is given
+ * one; `onEvict(key, value)` runs for entries pushed out by either budget.
+ */
+export class LruCache {
+  constructor({name = "cache", budget = Infinity, memory = Memory, sizeOf: measure = sizeOf, onEvict = null} = {}) {
+    this.name = name;
+    this.budget = budget;
+    this.memory = memory;
+    this.measure = measure;
+    this.onEvict = onEvict;
+    this.entries = new Map();
+    this.account = {bytes: 0};
+    this.member = null;
+    this.hits = 0;
+    this.misses = 0;
+    this.evictions = 0;
+  }
+
+  get size() {
+    return this.entries.size;
+  }
+
+  get bytes() {
+    return this.account.bytes;
+  }
+
+  // Value of a key, counted as hit or miss and marked most recently used.
+  get(key) {
+    let entry = this.entries.get(key);
+    if (!entry) {
+      this.misses++;
+      return undefined;
+    }
+    this.hits++;
+    this.entries.delete(key);
+    this.entries.set(key, entry);
+    entry.tick = this.memory ? ++this.memory.tick : 0;
+    return entry.value;
+  }
+
+  // Value of a key without touching stats or recency.
+  peek(key) {
+    let entry = this.entries.get(key);
+    return entry ? entry.value : undefined;
+  }
+
+  has(key) {
+    return this.entries.has(key);
+  }
+
+  set(key, value, size = this.measure(value) + sizeOf(key)) {
+    this.remove(key);
+    this.entries.set(key, {value, size, tick: this.memory ? ++this.memory.tick : 0});
+    this.resize(size);
+    if (this.memory) this.memory.register(this);
+    while (this.account.bytes > this.budget && this.entries.size > 1) this.evictOldest();
+    if (this.memory) this.memory.trim();
+    return this;
+  }
+
+  delete(key) {
+    return this.remove(key) !== undefined;
+  }
+
+  clear() {
+    this.resize(-this.account.bytes);
+    this.entries.clear();
+    if (this.memory) this.memory.unregister(this);
+  }
+
+  forEach(fn) {
+    this.entries.forEach((entry, key) => fn(entry.value, key, this));
+  }
+
+  keys() {
+    return this.entries.keys();
+  }
+
+  * values() {
+    for (let entry of this.entries.values()) yield entry.value;
+  }
+
+  oldestTick() {
+    let first = this.entries.values().next();
+    return first.done ? Infinity : first.value.tick;
+  }
+
+  evictOldest() {
+    let first = this.entries.entries().next();
+    if (first.done) return;
+    let [key, entry] = first.value;
+    this.remove(key);
+    this.evictions++;
+    if (this.onEvict) this.onEvict(key, entry.value);
+  }
+
+  remove(key) {
+    let entry = this.entries.get(key);
+    if (!entry) return undefined;
+    this.entries.delete(key);
+    this.resize(-entry.size);
+    return entry;
+  }
+
+  resize(delta) {
+    this.account.bytes += delta;
+    if (this.memory) this.memory.used += delta;
+  }
+
+  stats() {
+    let lookups = this.hits + this.misses;
+    return {
+      name: this.name,
+      entries: this.entries.size,
+      bytes: this.account.bytes,
+      budget: this.budget,
+      hits: this.hits,
+      misses: this.misses,
+      evictions: this.evictions,
+      hitRate: lookups ? this.hits / lookups : 0,
+    };
+  }
+}
@@ -1,12 +1,13 @@
 import {PrivateKey} from "bitsharesjs";
+import {Monitor} from "./monitor";
 
-const generateKeyFromPassword = (accountName, role, password) => {
+const generateKeyFromPassword = (accountName, role, password, prefix = "BTS") => Monitor.track("KeyFromPassword", () => {
   let seed = accountName + role + password;
   let privKey = PrivateKey.fromSeed(seed);
-  let pubKey = privKey.toPublicKey().toPublicKeyString("BTS");
+  let pubKey = privKey.toPublicKey().toPublicKeyString(prefix);
 
   return {privKey, pubKey};
-};
+});
 
 export const Crypto = {
   KeyFromPassword: generateKeyFromPassword,
@@ -0,0 +1,63 @@
+const abortError = (signal) => {
+  if (signal.reason instanceof Error) return signal.reason;
+  let err = new Error("The operation was aborted");
+  err.name = "AbortError";
+  return err;
+};
+
+const timeoutError = (timeout) => {
+  let err = new Error(`Deadline of ${timeout} ms exceeded`);
+  err.name = "TimeoutError";
+  return err;
+};
+
+export const Deadline = {
+  // Runs fn(signal) with a signal that aborts on `signal` or after `timeout` ms, whichever comes
+  // first. Without either fn gets null and pays nothing.
+  run: async ({signal = null, timeout = null} = {}, fn) => {
+    if (!timeout) {
+      Deadline.check(signal);
+      return await fn(signal);
+    }
+
+    let controller = new AbortController();
+    let abort = () => controller.abort(abortError(signal));
+    let timer = setTimeout(() => controller.abort(timeoutError(timeout)), timeout);
+    if (signal) {
+      if (signal.aborted) abort();
+      else signal.addEventListener("abort", abort);
+    }
+    try {
+      Deadline.check(controller.signal);
+      return await fn(controller.signal);
+    } finally {
+      clearTimeout(timer);
+      if (signal) signal.removeEventListener("abort", abort);
+    }
+  },
+
+  error: abortError,
+
+  check: (signal) => {
+    if (signal && signal.aborted) throw abortError(signal);
+  },
+
+  // Settles with `promise` unless the signal aborts first. The work behind `promise` is not stopped,
+  // only its result is dropped.
+  race: (promise, signal) => {
+    if (!signal) return promise;
+    if (signal.aborted) return Promise.reject(abortError(signal));
+    return new Promise((resolve, reject) => {
+      let abort = () => reject(abortError(signal));
+      signal.addEventListener("abort", abort);
+      promise.then(resolve, reject).finally(() => signal.removeEventListener("abort", abort));
+    });
+  },
+
+  // Calls onAbort when the signal aborts and returns a function that removes the listener.
+  listen: (signal, onAbort) => {
+    if (!signal) return () => null;
+    signal.addEventListener("abort", onAbort);
+    return () => signal.removeEventListener("abort", onAbort);
+  },
+};
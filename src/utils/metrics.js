@@ -0,0 +1,58 @@
+const now = () => (typeof performance !== "undefined" ? performance.now() : Date.now());
+
+// Timings and counters of one client; the default instance also collects process-wide metrics.
+export const createMetrics = () => {
+  const timings = {};
+  const counters = {};
+
+  const timing = (name, ms) => {
+    let t = timings[name];
+    if (!t) {
+      t = timings[name] = {count: 0, total: 0, min: Infinity, max: 0, last: 0};
+    }
+    t.count++;
+    t.total += ms;
+    t.last = ms;
+    if (ms < t.min) t.min = ms;
+    if (ms > t.max) t.max = ms;
+  };
+
+  const count = (name, n = 1) => {
+    counters[name] = (counters[name] || 0) + n;
+  };
+
+  return {
+    now: now,
+    timing: timing,
+    count: count,
+
+    // Times a promise-returning call and records it under `name`, successful or not.
+    timeAsync: async (name, fn) => {
+      let start = now();
+      try {
+        return await fn();
+      } catch (e) {
+        count(`${name}.error`);
+        throw e;
+      } finally {
+        timing(name, now() - start);
+      }
+    },
+
+    snapshot: () => {
+      let res = {timings: {}, counters: Object.assign({}, counters)};
+      for (let name in timings) {
+        let t = timings[name];
+        res.timings[name] = Object.assign({avg: t.total / t.count}, t);
+      }
+      return res;
+    },
+
+    reset: () => {
+      for (let name in timings) delete timings[name];
+      for (let name in counters) delete counters[name];
+    },
+  };
+};
+
+export const Metrics = createMetrics();
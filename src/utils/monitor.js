@@ -0,0 +1,81 @@
+import {Metrics} from "./metrics";
+
+const state = {
+  timer: null,
+  interval: 20,
+  threshold: 50,
+  expected: 0,
+  cpu: null,
+  window: [],
+  stalls: [],
+  maxStalls: 100,
+  onStall: null,
+};
+
+const cpuUsage = (prev) => (typeof process !== "undefined" && process.cpuUsage ? process.cpuUsage(prev) : null);
+
+// Ops run synchronously, so a stall is only observed on the next tick. Everything tracked since
+// the previous tick is therefore a suspect and the longest-running op gets the blame.
+const tick = () => {
+  let at = Metrics.now();
+  let lag = at - state.expected;
+  let ops = state.window;
+  state.window = [];
+
+  if (lag >= state.threshold) {
+    let cpu = cpuUsage(state.cpu);
+    let culprit = ops.reduce((a, b) => (!a || b.ms > a.ms ? b : a), null);
+    let op = culprit ? culprit.op : "unknown";
+    let stall = {
+      at: Date.now(),
+      lag: lag,
+      op: op,
+      ops: ops,
+      cpu: cpu ? (cpu.user + cpu.system) / 1000 : null,
+    };
+
+    Metrics.timing("loop.stall", lag);
+    Metrics.timing(`loop.stall.${op}`, lag);
+    state.stalls.push(stall);
+    if (state.stalls.length > state.maxStalls) state.stalls.shift();
+    if (state.onStall) state.onStall(stall);
+  }
+  Metrics.timing("loop.lag", Math.max(0, lag));
+
+  state.cpu = cpuUsage();
+  state.expected = Metrics.now() + state.interval;
+};
+
+export const Monitor = {
+  // Opt-in: until start() is called track() is a plain call with no bookkeeping.
+  start: ({interval = 20, threshold = 50, maxStalls = 100, onStall = null} = {}) => {
+    Monitor.stop();
+    Object.assign(state, {interval, threshold, maxStalls, onStall, window: []});
+    state.cpu = cpuUsage();
+    state.expected = Metrics.now() + interval;
+    state.timer = setInterval(tick, interval);
+    if (state.timer.unref) state.timer.unref();
+  },
+
+  stop: () => {
+    if (state.timer) clearInterval(state.timer);
+    state.timer = null;
+    state.window = [];
+  },
+
+  running: () => state.timer !== null,
+
+  track: (op, fn) => {
+    if (!state.timer) return fn();
+    let start = Metrics.now();
+    try {
+      return fn();
+    } finally {
+      let ms = Metrics.now() - start;
+      state.window.push({op, ms});
+      Metrics.timing(`op.${op}`, ms);
+    }
+  },
+
+  stalls: () => state.stalls.slice(),
+};
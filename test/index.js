@@ -1,7 +1,41 @@
 import {assert} from 'chai';
+import http from "http";
 import {Crypto} from "../src/utils/crypto";
 import {Account} from "../src/account/account";
-import {BitShares} from "../src/api/bitshares";
+import {BitShares, BitSharesClient} from "../src/api/bitshares";
+import {
+  allowedGateway,
+  getAssetGateway,
+  getAssetNamespace,
+  getFeaturedMarkets,
+  getFeaturedMarketsByAsset,
+  getFeaturedMarketsByBase,
+  getFeaturedMarketsByQuote,
+  getMyMarketsQuotes,
+} from "../src/branding";
+import {OrderBook, PriceLevels} from "../src/market/orderbook";
+import {TickerService} from "../src/market/tickers";
+import {OpenLedgerClient} from "../src/api/openledger";
+import {RpcApi, RpcSocket} from "../src/api/transport";
+import {Connection} from "../src/api/connection";
+import {KeyTable, projectAccount} from "../src/account/records";
+import {LruCache, MemoryBudget} from "../src/utils/cache";
+import {ObjectStore, objectType} from "../src/api/objects";
+import {Breaker, NodeHealth} from "../src/api/health";
+import {RateLimiter, isThrottle} from "../src/api/ratelimit";
+import {Priority, Scheduler} from "../src/api/scheduler";
+import {NodeSelector, nodeRegion, regionRings} from "../src/api/selector";
+import {NodeRegistry, normalizeUrl} from "../src/api/registry";
+import fs from "fs";
+import {BalanceBook, formatAmount} from "../src/account/balances";
+import {HistoryStream} from "../src/account/history";
+import {findAccountsByKeys, publicKeyString} from "../src/account/references";
+import {AssetRegistry} from "../src/api/assets";
+import {Broker, BrokerClient} from "../src/api/broker";
+import {AuthorityCache} from "../src/account/authorities";
+import WebSocket from "ws";
+import os from "os";
+import path from "path";
 
 describe('Test Crypto', () => {
   it('should test key generations from password', () => {
@@ -12,6 +46,1038 @@ describe('Test Crypto', () => {
   });
 });
 
+describe('Test Key References', () => {
+  it('should encode derived keys with the chain address prefix', () => {
+    let key = Crypto.KeyFromPassword("username1", "active", "password1");
+    let testKey = Crypto.KeyFromPassword("username1", "active", "password1", "TEST");
+    assert(publicKeyString(key) === key.pubKey);
+    assert(publicKeyString(key, "TEST") === testKey.pubKey && testKey.pubKey.indexOf("TEST") === 0);
+    assert(publicKeyString(key.pubKey, "TEST") === key.pubKey);
+  });
+
+  it('should look derived keys up under the chain prefix', async () => {
+    let key = Crypto.KeyFromPassword("username1", "active", "password1");
+    let testKey = Crypto.KeyFromPassword("username1", "active", "password1", "TEST").pubKey;
+    let client = {
+      chain: () => ({address_prefix: "TEST"}),
+      exec: (method, [keys]) => Promise.resolve(keys.map(k => (k === testKey ? ["1.2.5"] : []))),
+      objects: {getMany: ids => Promise.resolve(ids.map(id => ({id})))},
+    };
+    let [found] = await findAccountsByKeys(client, [key]);
+    assert(found.key === testKey && found.accounts[0].id === "1.2.5");
+  });
+});
+
+describe('Test Branding Registry', () => {
+  it('should resolve namespaces and gateways of asset symbols', () => {
+    assert(getMyMarketsQuotes() === getMyMarketsQuotes());
+    assert(Object.isFrozen(getMyMarketsQuotes()));
+    assert(getAssetNamespace("OPEN.BTC") === "OPEN.");
+    assert(getAssetGateway("RUDEX.GOLOS") === "RUDEX");
+    assert(getAssetGateway("CITADEL.NEW") === "CITADEL");
+    assert(getAssetNamespace("BTS") === null);
+    assert(allowedGateway("GDEX") && !allowedGateway("GDEX."));
+  });
+
+  it('should memoize featured markets per quote set', () => {
+    let markets = getFeaturedMarkets(["USD", "CNY"]);
+    assert(markets === getFeaturedMarkets(["CNY", "USD", "CNY"]));
+    assert(markets.every(m => m[0] === "USD" || m[0] === "CNY"));
+    assert(getFeaturedMarketsByAsset("OPEN.MAID").length === 3);
+  });
+
+  it('should index featured markets by base first and quote second', () => {
+    let byBase = getFeaturedMarketsByBase("USD");
+    assert(byBase.length > 0 && byBase.every(m => m[0] === "USD"));
+    assert(byBase.length === getFeaturedMarkets().filter(m => m[0] === "USD").length);
+    let byQuote = getFeaturedMarketsByQuote("OPEN.MAID");
+    assert(byQuote.length > 0 && byQuote.every(m => m[1] === "OPEN.MAID"));
+    assert(getFeaturedMarketsByBase("OPEN.MAID").every(m => m[0] === "OPEN.MAID"));
+  });
+});
+
+describe('Test Asset Registry', () => {
+  const known = {BTS: "1.3.0", USD: "1.3.121", CNY: "1.3.113", EUR: "1.3.120", GOLD: "1.3.106"};
+  const stubClient = (chainId = "chain-a", fail = null) => {
+    let client = {calls: [], chain: () => ({chain_id: chainId})};
+    client.api = () => ({
+      DB: {
+        AssetsBySymbols: (keys) => {
+          client.calls.push(keys);
+          return new Promise((resolve, reject) => setTimeout(() => {
+            if (fail) return reject(fail);
+            resolve(keys.map(key => (known[key] ? {id: known[key], symbol: key, precision: 4, issuer: "1.2.0"} : null)));
+          }, 5));
+        },
+      },
+    });
+    return client;
+  };
+
+  it('should fetch missing symbols in chunks', async () => {
+    let client = stubClient();
+    let assets = await new AssetRegistry(client, {chunkSize: 2}).resolve(["BTS", "USD", "CNY", "EUR", "GOLD"]);
+    assert(client.calls.map(keys => keys.length).join() === "2,2,1");
+    assert(assets[4].id === "1.3.106");
+  });
+
+  it('should join lookups already in flight', async () => {
+    let client = stubClient();
+    let registry = new AssetRegistry(client);
+    let [a, b] = await Promise.all([registry.resolve(["BTS"]), registry.resolve(["BTS", "1.3.0"])]);
+    assert(client.calls.length === 2 && a[0] === b[0] && b[1] === a[0]);
+  });
+
+  it('should fail joined lookups with the original error', async () => {
+    let error = new Error("node down");
+    let registry = new AssetRegistry(stubClient("chain-a", error));
+    let results = await Promise.all([registry.resolve(["BTS"]), registry.resolve(["BTS"])].map(p => p.catch(e => e)));
+    assert(results[0] === error && results[1] === error);
+  });
+
+  it('should look unknown symbols up again on every call', async () => {
+    let client = stubClient();
+    let registry = new AssetRegistry(client);
+    assert((await registry.resolve(["NOPE"]))[0] === null);
+    assert((await registry.resolve(["NOPE"]))[0] === null);
+    assert(client.calls.length === 2);
+  });
+
+  it('should only load files saved for the same chain', async () => {
+    let file = path.join(os.tmpdir(), `assets-${process.pid}.json`);
+    let registry = new AssetRegistry(stubClient("chain-a"));
+    await registry.resolve(["BTS", "USD"]);
+    await registry.save(file);
+    assert(await new AssetRegistry(stubClient("chain-b")).load(file) === 0);
+    let loaded = new AssetRegistry(stubClient("chain-a"));
+    assert(await loaded.load(file) === 2 && loaded.get("USD").id === "1.3.121");
+  });
+});
+
+describe('Test Ticker Service', () => {
+  it('should reject refreshes of a closed client instead of throwing in the timer', async () => {
+    let client = new BitSharesClient();
+    let tickers = new TickerService({client, interval: 5, markets: [["BTS", "USD"]]});
+    let error = await tickers.start().catch(e => e);
+    await new Promise(resolve => setTimeout(resolve, 30));
+    tickers.stop();
+    assert(String(error).indexOf("not connected") !== -1);
+    assert(client.metrics().counters["tickers.error"] >= 1);
+  });
+
+  it('should hand out snapshots later refreshes do not change', async () => {
+    let client = new BitSharesClient();
+    let price = 1;
+    client.api = () => ({DB: {
+      Ticker: () => Promise.resolve({latest: String(price)}),
+      Volume24: () => Promise.resolve({base_volume: "10"}),
+    }});
+    let tickers = new TickerService({client, markets: [["BTS", "USD"], ["BTS", "CNY"]]});
+    let first = await tickers.refresh();
+    price = 2;
+    tickers.markets = [["BTS", "USD"]];
+    let second = await tickers.refresh();
+    assert(first.markets.size === 2 && first.markets.get("USD_BTS").ticker.latest === "1");
+    assert(second.markets.size === 1 && second.markets.get("USD_BTS").ticker.latest === "2");
+    assert(Object.isFrozen(first) && Object.isFrozen(first.markets.get("CNY_BTS")));
+    let error = null;
+    try {
+      first.markets.delete("USD_BTS");
+    } catch (e) {
+      error = e;
+    }
+    assert(error instanceof TypeError && first.markets.has("USD_BTS"));
+  });
+});
+
+describe('Test Order Book Price Levels', () => {
+  it('should keep levels sorted and drop levels without orders', () => {
+    let bids = new PriceLevels(true);
+    for (let i = 0; i < 1000; i++) {
+      bids.add((i * 7919) % 1000, 1);
+    }
+    bids.add(999, 2);
+    assert(bids.size === 1000);
+    assert(bids.best().price === 999 && bids.best().orders === 2);
+    bids.add(999, -3, -2);
+    assert(bids.best().price === 998);
+    let top = bids.top(10).map(level => level.price);
+    assert(top.every((price, i) => i === 0 || top[i - 1] > price));
+  });
+});
+
+describe('Test Account Records', () => {
+  const owner = "BTS7Xyo7pJ6Bs9Ja5qPqeUwenzSSAr98hNcUmAsXJd8Umoug3aJMs";
+  const active = "BTS6f1LrXFZTzVP2Panv1dmji34C3bHHx2fXnw4ZVeZUGLGdPEC9Y";
+  const account = (id, name, memo) => ({
+    id, name,
+    owner: {weight_threshold: 1, key_auths: [[owner, 1]], account_auths: []},
+    active: {weight_threshold: 2, key_auths: [[active, 1], [owner, 1]], account_auths: [["1.2.17", 1]]},
+    options: {memo_key: memo, votes: ["1:0"]},
+  });
+
+  it('should intern keys shared between accounts', () => {
+    let keys = new KeyTable();
+    let a = projectAccount(account("1.2.100", "a", active), keys);
+    let b = projectAccount(account("1.2.101", "b", owner), keys);
+    assert(keys.count === 2);
+    assert(a.key("owner") === b.key("owner") && a.memo === a.key("active"));
+    assert(keys.toString(b.memo) === owner);
+    assert(a.threshold("active") === 2 && a.accountAuths("active")[0][0] === "1.2.17");
+    assert(a.objectId === "1.2.100" && a.options === undefined);
+  });
+
+  it('should drop keys of evicted records from the authority cache', () => {
+    let cache = new AuthorityCache({budget: 4096});
+    let memo;
+    for (let i = 0; i < 600; i++) {
+      memo = Crypto.KeyFromPassword(`user${i}`, "memo", "password1").pubKey;
+      let owner = Crypto.KeyFromPassword(`user${i}`, "owner", "password1").pubKey;
+      cache.set({
+        id: `1.2.${i}`, name: `user${i}`,
+        owner: {weight_threshold: 1, key_auths: [[owner, 1]], account_auths: []},
+        active: {weight_threshold: 1, key_auths: [[owner, 1]], account_auths: []},
+        options: {memo_key: memo},
+      });
+    }
+    assert(cache.keys.count < 1024 + 2 * cache.accounts.size);
+    assert(cache.keys.toString(cache.get("user599").memo) === memo);
+  });
+});
+
+describe('Test Byte-Bounded Cache', () => {
+  it('should evict least recently used entries across a shared budget', () => {
+    let memory = new MemoryBudget(10000);
+    let evicted = [];
+    let a = new LruCache({name: "a", memory, budget: 6000, onEvict: key => evicted.push(key)});
+    let b = new LruCache({name: "b", memory});
+    for (let i = 0; i < 100; i++) {
+      a.set(`k${i}`, "x".repeat(100));
+      a.get("k0");
+      b.set(`k${i}`, "y".repeat(100));
+    }
+    assert(memory.used <= 10000 && a.bytes <= 6000);
+    assert(a.has("k0") && !a.has("k1") && evicted[0] === "k1");
+    let stats = memory.stats().caches.find(c => c.name === "a");
+    assert(stats.hits === 100 && stats.evictions === evicted.length);
+  });
+});
+
+describe('Test Scheduler', () => {
+  // Occupies the scheduler's only slot until the returned release() is called.
+  const occupy = (scheduler) => {
+    let release;
+    scheduler.submit(() => new Promise(resolve => {
+      release = resolve;
+    }));
+    return () => release();
+  };
+
+  const queue = (scheduler, order, name, priority, signal = null) =>
+    scheduler.submit(() => order.push(name), {priority, signal});
+
+  it('should run classes by weighted fair queuing', async () => {
+    let scheduler = new Scheduler({concurrency: 1, reserved: 0});
+    let order = [];
+    let release = occupy(scheduler);
+    let done = Promise.all([
+      queue(scheduler, order, "d1", Priority.DEFAULT),
+      queue(scheduler, order, "d2", Priority.DEFAULT),
+      queue(scheduler, order, "b1", Priority.BACKGROUND),
+      queue(scheduler, order, "d3", Priority.DEFAULT),
+      queue(scheduler, order, "i1", Priority.INTERACTIVE),
+    ]);
+    release();
+    await done;
+    assert(order.join() === "i1,d1,d2,d3,b1");
+  });
+
+  it('should run aged bulk calls first but never ahead of interactive ones', async () => {
+    let scheduler = new Scheduler({concurrency: 1, reserved: 0, maxWait: 5});
+    let order = [];
+    let release = occupy(scheduler);
+    let aged = queue(scheduler, order, "b1", Priority.BACKGROUND);
+    await new Promise(resolve => setTimeout(resolve, 10));
+    let done = Promise.all([aged, queue(scheduler, order, "d1", Priority.DEFAULT)]);
+    await new Promise(resolve => setTimeout(resolve, 10));
+    done = Promise.all([done, queue(scheduler, order, "i1", Priority.INTERACTIVE)]);
+    release();
+    await done;
+    assert(order.join() === "i1,b1,d1");
+  });
+
+  it('should keep reserved slots for interactive calls', async () => {
+    let scheduler = new Scheduler({concurrency: 2, reserved: 1});
+    let order = [];
+    let release = occupy(scheduler);
+    let bulk = queue(scheduler, order, "d1", Priority.DEFAULT);
+    await queue(scheduler, order, "i1", Priority.INTERACTIVE);
+    assert(order.join() === "i1" && scheduler.active === 1 && scheduler.queued === 1);
+    release();
+    await bulk;
+    assert(order.join() === "i1,d1" && scheduler.pending === 0);
+  });
+
+  it('should drop calls aborted while queued', async () => {
+    let scheduler = new Scheduler({concurrency: 1, reserved: 0});
+    let order = [];
+    let controller = new AbortController();
+    let release = occupy(scheduler);
+    let aborted = queue(scheduler, order, "d1", Priority.DEFAULT, controller.signal);
+    let kept = queue(scheduler, order, "d2", Priority.DEFAULT);
+    controller.abort();
+    let error = await aborted.catch(e => e);
+    assert(error.name === "AbortError" && scheduler.queued === 1);
+    release();
+    await kept;
+    assert(order.join() === "d2");
+  });
+});
+
+describe('Test Rate Limiter', () => {
+  const replyError = (message) => Object.assign(new Error(message), {reply: true});
+
+  it('should only take status 429 or its reason phrase for throttling', () => {
+    assert(isThrottle({code: 429, message: "Too Many Requests"}));
+    assert(isThrottle(Object.assign(new Error("Could not connect"), {status: 429})));
+    assert(isThrottle(new Error("429 Too Many Requests")));
+    assert(!isThrottle(replyError("Unable to find Object 1.2.14290")));
+    assert(!isThrottle(replyError("Assert Exception: limit exceeded")));
+    assert(!isThrottle(replyError("too many requests")) && !isThrottle({message: "Too many requests"}));
+    assert(!isThrottle(new Error("Connection to wss://node timed out")) && !isThrottle(null));
+  });
+
+  it('should halve the rate on throttling but not on node replies', () => {
+    let limiter = new RateLimiter({rate: 40});
+    limiter.record(10, replyError("Unable to find Object 1.2.14290"));
+    assert(limiter.rate === 40 && limiter.throttled === 0);
+    limiter.record(10, replyError("Assert Exception: limit exceeded"));
+    limiter.record(10, Object.assign(replyError("Too Many Requests"), {code: 429}));
+    assert(limiter.rate === 20 && limiter.throttled === 1);
+  });
+});
+
+describe('Test Node Health', () => {
+  const replyError = (message) => Object.assign(new Error(message), {reply: true});
+
+  it('should not count errors the node answered with', () => {
+    let health = new NodeHealth("wss://node", {maxErrorRate: 0.5});
+    for (let i = 0; i < 20; i++) {
+      health.record(10, replyError("Assert Exception: account != nullptr"));
+      health.record(10, {code: 1, message: "Assert Exception"});
+    }
+    assert(health.state === Breaker.CLOSED && health.errorRate === 0 && health.latency === 10);
+  });
+
+  it('should open past the error rate threshold on node failures', () => {
+    let health = new NodeHealth("wss://node", {alpha: 0.5, maxErrorRate: 0.6});
+    health.record(10, new Error("Connection to wss://node timed out"));
+    assert(health.errorRate === 0.5 && health.state === Breaker.CLOSED);
+    health.record(10, Object.assign(replyError("Too Many Requests"), {code: 429}));
+    assert(health.errorRate === 0.75 && health.state === Breaker.OPEN && health.reason === "error rate");
+    assert(!health.available());
+  });
+
+  it('should close after a good trial and back off after a failed one', () => {
+    let health = new NodeHealth("wss://node", {cooldown: 1000, maxCooldown: 3000});
+    health.trip("probe failed");
+    assert(!health.available());
+    health.openedAt -= 1000;
+    assert(health.available() && health.state === Breaker.HALF_OPEN);
+    health.admit();
+    assert(!health.available());
+    health.record(10, new Error("Connection to wss://node closed"));
+    assert(health.state === Breaker.OPEN && health.cooldown === 2000);
+    health.openedAt -= 2000;
+    assert(health.available());
+    health.record(10, new Error("Connection to wss://node closed"));
+    assert(health.cooldown === 3000);
+    health.openedAt -= 3000;
+    assert(health.available());
+    health.record(10, null);
+    assert(health.state === Breaker.CLOSED && health.cooldown === 1000 && health.available());
+  });
+});
+
+describe('Test Node Selector', () => {
+  const nodes = [
+    {url: "wss://asia", region: "Eastern Asia"},
+    {url: "wss://west", region: "Western Europe"},
+    {url: "wss://nowhere", region: "Unknown"},
+    {url: "wss://north", region: "Northern Europe"},
+    {url: "wss://africa", region: "Northern Africa"},
+    {url: "wss://europe", region: "Europe"},
+    {url: "wss://america", region: "North America"},
+  ];
+  const rtts = {"wss://asia": 300, "wss://west": 50, "wss://nowhere": 10, "wss://north": null, "wss://africa": 30,
+    "wss://europe": 80, "wss://america": 200};
+
+  it('should normalize node regions', () => {
+    assert(nodeRegion({region: "TESTNET - Western Europe"}) === "Western Europe");
+    assert(nodeRegion({region: "North America"}) === "Northern America");
+    assert(nodeRegion({region: "Europe"}) === "Europe");
+    assert(nodeRegion({region: "Unknown"}) === null && nodeRegion({}) === null);
+  });
+
+  it('should ring nodes by distance from a region', () => {
+    let rings = regionRings(nodes, "Western Europe").map(ring => ring.map(node => node.url).join());
+    assert(rings.join("|") ===
+      "wss://west|wss://north,wss://europe|wss://africa|wss://asia|wss://america|wss://nowhere");
+    assert(regionRings(nodes, null)[0].map(node => node.url).join() === "wss://west,wss://north,wss://europe");
+  });
+
+  it('should widen ring by ring until enough nodes answered', async () => {
+    let probed = [];
+    let probe = url => {
+      probed.push(url);
+      return Promise.resolve(rtts[url]);
+    };
+    let {region, nodes: selected, failed} =
+      await NodeSelector.select({region: "Western Europe", count: 3, nodes, probe});
+    assert(region === "Western Europe");
+    assert(selected.map(node => node.url).join() === "wss://west,wss://europe,wss://africa");
+    assert(failed.join() === "wss://north");
+    assert(probed.indexOf("wss://asia") === -1 && probed.indexOf("wss://nowhere") === -1);
+  });
+
+  it('should infer the region from the nearest sampled node and skip nodes', async () => {
+    let probe = url => Promise.resolve(rtts[url]);
+    let skip = url => url === "wss://africa";
+    let {region, nodes: selected} = await NodeSelector.select({count: 1, nodes, probe, skip});
+    assert(region === "Western Europe");
+    assert(selected.length === 1 && selected[0].url === "wss://west" && selected[0].rtt === 50);
+  });
+});
+
+describe('Test Node Registry', () => {
+  it('should normalize node urls', () => {
+    assert(normalizeUrl(" WSS://Node.Example.com:443/ws/ ") === "wss://node.example.com/ws");
+    assert(normalizeUrl("ws://node.example.com:80") === "ws://node.example.com");
+    assert(normalizeUrl("wss://node.example.com:8090/?x=1") === "wss://node.example.com:8090?x=1");
+    assert(normalizeUrl("https://node.example.com") === null && normalizeUrl("node") === null);
+    assert(normalizeUrl(null) === null);
+  });
+
+  it('should merge and dedup operator nodes from the environment and a file at construction', async () => {
+    let file = path.join(os.tmpdir(), `nodes-${process.pid}.json`);
+    let operator = [{url: "wss://a.example.com", region: "Western Europe"}, "ws://127.0.0.1:8090"];
+    fs.writeFileSync(file, JSON.stringify(operator));
+    process.env.TEST_BITSHARES_NODES = "wss://A.example.com:443/, wss://b.example.com/ws";
+    let builtin = [
+      {url: "wss://a.example.com/", region: "Eastern Asia", location: "Tokyo"},
+      {url: "ws://localhost:8090"},
+    ];
+    let changes = [];
+    try {
+      let onChange = change => changes.push(change);
+      let registry = new NodeRegistry({builtin, path: file, env: "TEST_BITSHARES_NODES", onChange});
+      let nodes = registry.list();
+      assert(nodes.map(node => node.url).join() === "wss://a.example.com,wss://b.example.com/ws,ws://127.0.0.1:8090");
+      assert(nodes[0].region === "Western Europe" && nodes[0].location === "Tokyo" && nodes[0].source === "file");
+      assert(nodes[1].source === "env" && !registry.has("ws://localhost:8090") && changes.length === 0);
+
+      fs.writeFileSync(file, "[not json");
+      delete process.env.TEST_BITSHARES_NODES;
+      let {added, removed} = await registry.reload();
+      assert(added.length === 0 && removed.join() === "wss://b.example.com/ws" && changes.length === 1);
+      assert(registry.has("ws://127.0.0.1:8090") && registry.list()[0].region === "Western Europe");
+    } finally {
+      delete process.env.TEST_BITSHARES_NODES;
+      fs.unlinkSync(file);
+    }
+  });
+});
+
+describe('Test Object Ids', () => {
+  it('should type object ids by space and type', () => {
+    assert(objectType("1.2.17") === "account");
+    assert(objectType("1.3.0") === "asset");
+    assert(objectType("2.1.0") === "dynamic_global_property");
+    assert(objectType("1.2") === null && objectType("9.9.9") === null);
+  });
+});
+
+describe('Test Object Store', () => {
+  const stubClient = () => {
+    let client = {calls: [], subscribes: 0, metricsRegistry: {count: () => null}};
+    client.connections = [{exec: () => {
+      client.subscribes++;
+      return Promise.resolve(null);
+    }}];
+    client.exec = (method, [ids]) => {
+      client.calls.push(ids);
+      return new Promise(resolve => setTimeout(() => resolve(ids.map(id => ({id, name: `n${id}`}))), 5));
+    };
+    return client;
+  };
+
+  it('should batch gets of one tick in chunks of chunkSize', async () => {
+    let client = stubClient();
+    let store = new ObjectStore(client, {chunkSize: 2});
+    let [many, one] = await Promise.all([store.getMany(["1.2.1", "1.2.2", "1.2.3"]), store.get("1.2.4")]);
+    assert(client.calls.map(ids => ids.join()).join("|") === "1.2.1,1.2.2|1.2.3,1.2.4");
+    assert(many[2].name === "n1.2.3" && one.name === "n1.2.4");
+  });
+
+  it('should join ids in flight and serve cached ones', async () => {
+    let client = stubClient();
+    let store = new ObjectStore(client);
+    let first = store.get("1.2.1");
+    await new Promise(resolve => setImmediate(resolve));
+    let [a, b] = await Promise.all([first, store.get("1.2.1")]);
+    await store.get("1.2.1");
+    assert(client.calls.length === 1 && a === b);
+  });
+
+  it('should replace and remove cached objects on notices', async () => {
+    let client = stubClient();
+    let store = new ObjectStore(client);
+    await store.getMany(["1.2.1", "1.2.2"]);
+    store.notice([[{id: "1.2.1", name: "changed"}, {id: "1.2.9", name: "unknown"}, "1.2.2"]]);
+    assert(store.cache.peek("1.2.1").object.name === "changed" && !store.cache.has("1.2.9"));
+    let [changed, removed] = await store.getMany(["1.2.1", "1.2.2"]);
+    assert(changed.name === "changed" && removed.name === "n1.2.2" && client.calls.length === 2);
+  });
+
+  it('should subscribe each connection once and again after a reconnect', async () => {
+    let client = stubClient();
+    let store = new ObjectStore(client);
+    await store.get("1.2.1");
+    await store.get("1.2.2");
+    assert(client.subscribes === 1);
+    store.resubscribe(client.connections[0]);
+    assert(client.subscribes === 2);
+
+    let owner = new BitSharesClient();
+    owner.objects = store;
+    owner.connections = client.connections;
+    owner.status("closed", client.connections[0]);
+    owner.status("reconnect", client.connections[0]);
+    assert(client.subscribes === 3);
+  });
+});
+
+describe('Test Balance Amounts', () => {
+  it('should format integer amounts as exact fixed-point strings', () => {
+    assert(formatAmount("900719925474099312", 5) === "9007199254740.99312");
+    assert(formatAmount(5, 4) === "0.0005");
+    assert(formatAmount(7, 0) === "7");
+  });
+
+  // Accounts alice (1.2.5) and 1.2.7 holding 1.3.0, plus 1.2.8 holding an asset the node does not know.
+  const stubClient = () => {
+    let client = {block: 100, lookups: [], calls: []};
+    let accounts = {"1.2.5": {id: "1.2.5", name: "alice"}, "1.2.7": {id: "1.2.7"}, "1.2.8": {id: "1.2.8"}};
+    let bts = {id: "1.3.0", symbol: "BTS", precision: 5};
+    client.assets = {resolve: ids => Promise.resolve(ids.map(id => (id === bts.id ? bts : null)))};
+    client.objects = {
+      get: id => Promise.resolve(id === "2.1.0" ? {head_block_number: client.block} : accounts[id] || null),
+    };
+    client.api = () => ({DB: {AccountByName: name => {
+      client.lookups.push(name);
+      return Promise.resolve(name === "alice" ? accounts["1.2.5"] : null);
+    }}});
+    client.exec = (method, [id]) => {
+      client.calls.push(id);
+      return Promise.resolve([{asset_id: id === "1.2.8" ? "1.3.9" : "1.3.0", amount: "1234500"}]);
+    };
+    return client;
+  };
+
+  it('should fetch each account once per head block and give null for unknown accounts', async () => {
+    let client = stubClient();
+    let book = new BalanceBook(client);
+    let [a, b, c, d, e] = await book.get(["alice", "alice", "1.2.7", "nobody", "1.2.404"]);
+    assert(a[0].value === "12.34500" && a[0].symbol === "BTS" && b[0].value === a[0].value);
+    assert(c[0].amount === "1234500");
+    assert(d === null && e === null);
+    assert(client.calls.join() === "1.2.5,1.2.7" && client.lookups.join() === "alice,nobody");
+
+    await book.get(["alice", "1.2.7"]);
+    assert(client.calls.length === 2);
+    client.block++;
+    await book.get(["alice", "1.2.7", "nobody"]);
+    assert(client.calls.join() === "1.2.5,1.2.7,1.2.5,1.2.7" && client.lookups.join() === "alice,nobody,nobody");
+  });
+
+  it('should reject balances in an asset it cannot resolve', async () => {
+    let error = await new BalanceBook(stubClient()).get(["1.2.8"]).catch(e => e);
+    assert(error.message === "Unknown asset 1.3.9");
+  });
+});
+
+describe('Test History Stream', () => {
+  // Account 1.2.5 with operations of the given instance ids, newest first. Pages resolve after
+  // `delay` ms and the `fail`-th call is rejected.
+  const stubClient = (instances, {delay = 1, fail = 0} = {}) => {
+    let client = {calls: []};
+    client.objects = {
+      get: id => Promise.resolve(id === "1.2.5" ? {id, statistics: "2.6.5"} : {total_ops: instances.length}),
+    };
+    client.exec = (method, [account, stop, limit, start]) => {
+      client.calls.push(start);
+      let page;
+      if (method === "get_relative_account_history") {
+        // Sequence numbers run from 1 to total_ops, oldest first.
+        page = instances.filter((id, i) => instances.length - i <= start).slice(0, limit);
+      } else {
+        let from = Number(start.split(".")[2]);
+        page = instances.filter(id => !from || id <= from).slice(0, limit);
+      }
+      let result = page.map(id => ({id: `1.11.${id}`}));
+      return new Promise((resolve, reject) => setTimeout(() => {
+        if (client.calls.length === fail) reject(new Error("history failed"));
+        else resolve(result);
+      }, delay));
+    };
+    return client;
+  };
+
+  const collect = async (stream) => {
+    let ids = [];
+    for (let step = await stream.next(); !step.done; step = await stream.next()) ids.push(step.value.id);
+    return ids;
+  };
+
+  it('should page by operation id until a short or empty page', async () => {
+    let client = stubClient([12, 9, 5, 1]);
+    let ids = await collect(new HistoryStream(client, "1.2.5", {pageSize: 2}));
+    assert(ids.join() === "1.11.12,1.11.9,1.11.5,1.11.1");
+    assert(client.calls.join() === "1.11.0,1.11.8");
+
+    client = stubClient([12, 9, 5, 3]);
+    ids = await collect(new HistoryStream(client, "1.2.5", {pageSize: 2}));
+    assert(ids.length === 4 && client.calls.join() === "1.11.0,1.11.8,1.11.2");
+  });
+
+  it('should page relative history down to the first sequence number', async () => {
+    let client = stubClient([6, 5, 4, 3, 2, 1]);
+    let ids = await collect(new HistoryStream(client, "1.2.5", {pageSize: 3, relative: true}));
+    assert(ids.length === 6 && client.calls.join() === "6,3");
+
+    client = stubClient([7, 6, 5, 4, 3, 2, 1]);
+    ids = await collect(new HistoryStream(client, "1.2.5", {pageSize: 3, relative: true}));
+    assert(ids.join() === "1.11.7,1.11.6,1.11.5,1.11.4,1.11.3,1.11.2,1.11.1" && client.calls.join() === "7,4,1");
+  });
+
+  it('should fetch at most prefetch pages ahead of the consumer', async () => {
+    let client = stubClient(Array.from({length: 20}, (_, i) => 20 - i));
+    let stream = new HistoryStream(client, "1.2.5", {pageSize: 2, prefetch: 2});
+    await stream.next();
+    await new Promise(resolve => setTimeout(resolve, 30));
+    assert(client.calls.length === 3);
+    await stream.return();
+  });
+
+  it('should end on return() or an aborted signal while a page is in flight', async () => {
+    let client = stubClient([4, 3, 2, 1], {delay: 10});
+    let stream = new HistoryStream(client, "1.2.5", {pageSize: 2});
+    await stream.next();
+    let ended = await stream.return();
+    await new Promise(resolve => setTimeout(resolve, 30));
+    assert(ended.done && (await stream.next()).done && client.calls.length === 2);
+
+    let controller = new AbortController();
+    client = stubClient([4, 3, 2, 1], {delay: 10});
+    stream = new HistoryStream(client, "1.2.5", {pageSize: 2, signal: controller.signal});
+    let pending = stream.next();
+    setTimeout(() => controller.abort(), 2);
+    let error = await pending.catch(e => e);
+    await new Promise(resolve => setTimeout(resolve, 30));
+    assert(error.name === "AbortError" && client.calls.length === 1);
+  });
+
+  it('should throw a failed page from next() after the pages before it', async () => {
+    let client = stubClient([4, 3, 2, 1], {fail: 2});
+    let stream = new HistoryStream(client, "1.2.5", {pageSize: 2});
+    let first = await stream.next();
+    let second = await stream.next();
+    let error = await stream.next().catch(e => e);
+    assert(first.value.id === "1.11.4" && second.value.id === "1.11.3");
+    assert(error.message === "history failed");
+  });
+});
+
+describe('Test Order Book', () => {
+  const order = (id, forSale) => ({
+    id, for_sale: forSale,
+    sell_price: {base: {asset_id: "1.3.0", amount: 200000}, quote: {asset_id: "1.3.121", amount: 10000}},
+  });
+
+  // Unsubscribing wants the callback given to SubscribeMarket first, as ChainWebSocket does, and
+  // notices keep coming until the unsubscribe resolves.
+  const stubClient = ({snapshot = async () => [order("1.7.1", 100000)]} = {}) => {
+    let client = {calls: [], callback: null};
+    client.metricsRegistry = {timeAsync: (name, fn) => fn(), count: () => null};
+    client.assets = {resolve: async () => [{id: "1.3.0", precision: 5}, {id: "1.3.121", precision: 4}]};
+    client.api = () => ({DB: {
+      SubscribeMarket: async callback => {
+        client.calls.push("subscribe");
+        client.callback = callback;
+      },
+      LimitOrders: snapshot,
+      UnsubscribeMarket: async (callback, base, quote) => {
+        if (callback !== client.callback) throw new Error("First parameter of unsub must be the original callback");
+        client.callback([[order("1.7.2", 50000)]]);
+        client.calls.push(`unsubscribe ${base} ${quote}`);
+      },
+    }});
+    return client;
+  };
+
+  it('should unsubscribe and stop buffering when the snapshot fails', async () => {
+    let error = new Error("snapshot failed");
+    let client = stubClient({snapshot: async () => {
+      throw error;
+    }});
+    let book = new OrderBook("BTS", "USD", {client});
+    assert(await book.start().catch(e => e) === error);
+    assert(client.calls.join() === "subscribe,unsubscribe 1.3.0 1.3.121");
+    assert(book.pending === null && book.assets === null);
+    client.callback([[order("1.7.3", 1000)]]);
+    assert(book.orders.size === 0);
+  });
+
+  it('should unsubscribe with its callback on stop and drop later notices', async () => {
+    let client = stubClient();
+    let book = await new OrderBook("BTS", "USD", {client}).start();
+    assert(book.orders.size === 1 && book.bestBid().price === 2);
+    await book.stop();
+    assert(client.calls.join() === "subscribe,unsubscribe 1.3.0 1.3.121" && book.assets === null);
+    assert(book.orders.size === 2);
+    client.callback([[order("1.7.3", 1000), "1.7.1"]]);
+    assert(book.orders.size === 2);
+  });
+});
+
+describe('Test OpenLedger Client', () => {
+  let hits = {};
+  let server;
+  let client;
+
+  before(done => {
+    server = http.createServer((req, res) => {
+      hits[req.url] = (hits[req.url] || 0) + 1;
+      if (req.url === "/coins" && req.headers["if-none-match"] === '"v1"') {
+        res.writeHead(304);
+        return res.end();
+      }
+      let headers = {"Content-Type": "application/json", ETag: '"v1"', "Cache-Control": "no-cache"};
+      setTimeout(() => {
+        res.writeHead(200, headers);
+        res.end(req.url === "/coins" ? '[{"coinType":"btc"}]' : '{"outputAmount":"1"}');
+      }, 10);
+    }).listen(0, () => {
+      client = new OpenLedgerClient({base: `http://127.0.0.1:${server.address().port}`});
+      done();
+    });
+  });
+
+  after(() => {
+    client.agent.destroy();
+    server.close();
+  });
+
+  it('should revalidate cached lists with etag', async () => {
+    let first = await client.coins();
+    let second = await client.coins();
+    assert(first === second && first[0].coinType === "btc");
+    assert(hits["/coins"] === 2);
+  });
+
+  it('should coalesce identical estimate queries', async () => {
+    let [a, b] = await Promise.all([
+      client.estimateOutput(1, "btc", "open.btc"),
+      client.estimateOutput(1, "btc", "open.btc"),
+    ]);
+    assert(a === b);
+    assert(Object.keys(hits).filter(url => url.startsWith("/estimate-output-amount")).length === 1);
+  });
+
+  it('should keep cached lists within the budget', async () => {
+    let small = new OpenLedgerClient({base: client.base, budget: 1});
+    await small.coins();
+    await small.tradingPairs();
+    assert(small.cache.size === 1 && !small.cache.has("/coins"));
+    small.agent.destroy();
+  });
+});
+
+describe('Test Connection Broker', () => {
+  // A broker over a client whose node answers after 10ms, recording the methods it was sent.
+  const serve = () => {
+    let server = new BitSharesClient();
+    server.calls = [];
+    server.exec = (method, params) => {
+      server.calls.push(method);
+      return new Promise(resolve => setTimeout(() => resolve(method === "get_objects"
+        ? params[0].map(id => ({id})) : params), 10));
+    };
+    server.assets.lookup = (keys) => {
+      server.calls.push("lookup_asset_symbols");
+      return Promise.resolve(keys.map(symbol => ({id: "1.3.0", symbol, precision: 5, issuer: "1.2.0"})));
+    };
+    return server;
+  };
+
+  it('should send calls of one tick as one batch and dedup identical ones', async () => {
+    let server = serve();
+    let client = new BrokerClient(Broker.channel(server));
+    let [a, b, c] = await Promise.all([
+      client.exec("get_block", [1]),
+      client.exec("get_block", [1]),
+      client.exec("get_block", [2]),
+    ]);
+    assert(a.join() === "1" && b.join() === "1" && c.join() === "2");
+    assert(server.calls.join() === "get_block,get_block");
+    let counters = server.metrics().counters;
+    assert(counters["broker.batch"] === 1 && counters["broker.dedup"] === 1);
+    client.close();
+  });
+
+  it('should cancel aborted calls and still answer the other waiters', async () => {
+    let server = serve();
+    let client = new BrokerClient(Broker.channel(server));
+    let controller = new AbortController();
+    let aborted = client.exec("get_block", [1], {signal: controller.signal}).then(() => null, e => e);
+    let other = client.exec("get_block", [1]);
+    await new Promise(resolve => setImmediate(resolve));
+    controller.abort();
+    let queued = new AbortController();
+    let never = client.exec("get_block", [3], {signal: queued.signal}).then(() => null, e => e);
+    queued.abort();
+    assert((await aborted).name === "AbortError" && (await never).name === "AbortError");
+    assert((await other).join() === "1" && server.calls.join() === "get_block");
+    client.close();
+  });
+
+  it('should serve objects and assets from the caches of the broker', async () => {
+    let server = serve();
+    let client = new BrokerClient(Broker.channel(server));
+    await client.objects.get("1.2.5");
+    let object = await client.objects.get("1.2.5");
+    assert(object.id === "1.2.5" && server.calls.join() === "get_objects");
+    await client.assets.resolve(["BTS"]);
+    let other = new BrokerClient(Broker.channel(server));
+    let [asset] = await other.assets.resolve(["BTS"]);
+    assert(asset.symbol === "BTS" && server.calls.join() === "get_objects,lookup_asset_symbols");
+    client.close();
+    other.close();
+  });
+});
+
+describe('Test RPC Transport', () => {
+  let server;
+  let socket;
+  let subscriptions = [];
+
+  const chainId = "4018d7844c78f6a6c41c6a552b898022310fc5dec06da467ee7905a8dad512c8";
+  const reply = (api, method, params) => {
+    if (api === 1) return method === "login" ? true : 2;
+    return method === "get_chain_id" ? chainId : params;
+  };
+
+  // Mock node: accepts the upgrade after 20 ms and answers in reverse order so replies arrive out
+  // of order.
+  before(done => {
+    let verifyClient = (info, accept) => setTimeout(() => accept(true), 20);
+    server = new WebSocket.Server({port: 0, perMessageDeflate: true, verifyClient}, () => {
+      socket = new RpcSocket(`ws://127.0.0.1:${server.address().port}`, null, 5000, false);
+      done();
+    });
+    server.on("connection", ws => {
+      let queue = [];
+      ws.on("message", text => {
+        let {id, params: [api, method, params]} = JSON.parse(text);
+        if (method === "subscribe_to_market") subscriptions.push({ws, params});
+        queue.unshift(JSON.stringify(method === "fail" ?
+          {id, error: {message: "failed"}} :
+          {id, jsonrpc: "2.0", result: reply(api, method, params)}));
+        setImmediate(() => queue.splice(0).forEach(reply => ws.send(reply)));
+      });
+    });
+  });
+
+  after(() => socket.close().then(() => server.close()));
+
+  it('should pipeline calls over one socket', async () => {
+    await socket.connect_promise;
+    let results = await Promise.all(Array.from({length: 200}, (_, i) => socket.call([2, "echo", [i]])));
+    assert(results.every((params, i) => params[0] === i));
+    assert(socket.inflight === 0);
+  });
+
+  it('should open a default transport connection with the default timeout', async () => {
+    let connection = new Connection(`ws://127.0.0.1:${server.address().port}`, {autoReconnect: false});
+    await connection.open();
+    assert(connection.chain.chain_id === chainId);
+    await connection.close();
+  });
+
+  it('should subscribe again after a reconnect', async () => {
+    let reconnecting = new RpcSocket(`ws://127.0.0.1:${server.address().port}`, null, 5000, true);
+    let api = new RpcApi(reconnecting, "database");
+    let notices = [];
+    let reconnected = new Promise(resolve => {
+      reconnecting.on_reconnect = () => api.init().then(resolve);
+    });
+    await reconnecting.connect_promise;
+    await api.init();
+    await api.exec("subscribe_to_market", [update => notices.push(update), "1.3.0", "1.3.1"]);
+    let other = () => null;
+    await api.exec("subscribe_to_market", [other, "1.3.0", "1.3.2"]);
+    let [unsubscribed] = await Promise.all([
+      api.exec("unsubscribe_from_market", [other, "1.3.0", "1.3.2"]),
+      api.exec("unsubscribe_from_market", ["1.3.0", "1.3.1"]).catch(e => e),
+    ]);
+    assert(unsubscribed.join() === "1.3.0,1.3.2" && reconnecting.subs.size === 1);
+    subscriptions[0].ws.terminate();
+    subscriptions = [];
+
+    await reconnected;
+    assert(subscriptions.length === 1 && subscriptions[0].params.slice(1).join() === "1.3.0,1.3.1");
+    let {ws, params: [id]} = subscriptions[0];
+    ws.send(JSON.stringify({method: "notice", params: [id, [["1.7.1"]]]}));
+    await new Promise(resolve => setTimeout(resolve, 20));
+    assert(notices.length === 1 && notices[0][0][0] === "1.7.1");
+    await reconnecting.close();
+  });
+
+  it('should not reconnect or keep a socket once closed', async () => {
+    let url = `ws://127.0.0.1:${server.address().port}`;
+    let before = new Set(server.clients);
+    let backingOff = new RpcSocket(url, null, 5000, true);
+    await backingOff.connect_promise;
+    let [peer] = Array.from(server.clients).filter(ws => !before.has(ws));
+    await new Promise(resolve => {
+      backingOff.statusCb = status => status === "closed" && resolve();
+      peer.terminate();
+    });
+    await backingOff.close();
+
+    let connecting = new RpcSocket(url, null, 5000, true);
+    await connecting.close();
+    let error = await connecting.connect_promise.catch(e => e);
+    await new Promise(resolve => setTimeout(resolve, 700));
+    assert(backingOff.reconnectTimer === null && !backingOff.ws && !connecting.ws);
+    assert(error.message.indexOf("closed") !== -1 && server.clients.size === before.size);
+  });
+
+  it('should reject calls the node fails', async () => {
+    let error = await socket.call([2, "fail", []]).catch(e => e);
+    assert(error.message === "failed");
+  });
+
+  it('should negotiate permessage-deflate when asked', async () => {
+    let compressed = new RpcSocket(`ws://127.0.0.1:${server.address().port}`, null, 5000, false, {compression: true});
+    await compressed.connect_promise;
+    let [text] = await compressed.call([2, "echo", ["bitshares ".repeat(5000)]]);
+    let stats = compressed.stats();
+    await compressed.close();
+    assert(text.length === 50000);
+    assert(stats.compressed && stats.ratio < 0.5);
+  });
+
+  it('should only fall back to plain frames when the handshake fails', async () => {
+    let counts = [];
+    let metrics = {count: name => counts.push(name), timing: () => null, now: () => 0};
+    let settings = {compression: true, metrics};
+    let verifyClient = info => !/permessage-deflate/.test(info.req.headers["sec-websocket-extensions"] || "");
+    let plain = new WebSocket.Server({port: 0, perMessageDeflate: true, verifyClient});
+    plain.on("connection", ws => ws.on("message", text => {
+      let {id, params: [, , params]} = JSON.parse(text);
+      ws.send(JSON.stringify({id, result: params}));
+    }));
+    await new Promise(resolve => plain.on("listening", resolve));
+    let port = plain.address().port;
+
+    let fallback = new RpcSocket(`ws://127.0.0.1:${port}`, null, 5000, false, settings);
+    await fallback.connect_promise;
+    let [text] = await fallback.call([2, "echo", ["бит"]]);
+    let stats = fallback.stats();
+    await fallback.close();
+    await new Promise(resolve => plain.close(resolve));
+    assert(text === "бит" && !stats.compressed && counts.indexOf("transport.deflate.fallback") !== -1);
+    assert(stats.payloadBytes === Buffer.byteLength(JSON.stringify({id: 1, result: ["бит"]})));
+
+    counts = [];
+    let refused = new RpcSocket(`ws://127.0.0.1:${port}`, null, 5000, false, settings);
+    let error = await refused.connect_promise.catch(e => e);
+    assert(error instanceof Error && !error.handshake && counts.length === 0);
+  });
+});
+
+describe('Test Cached Login', () => {
+  const name = "username1";
+  const password = "password1";
+  const pub = (role, secret = password) => Crypto.KeyFromPassword(name, role, secret).pubKey;
+  const account = ({owner = pub("owner"), active = pub("active"), memo = pub("memo")} = {}) => ({
+    id: "1.2.5", name,
+    owner: {weight_threshold: 1, key_auths: [[owner, 1]], account_auths: []},
+    active: {weight_threshold: 1, key_auths: [[active, 1]], account_auths: []},
+    options: {memo_key: memo},
+  });
+
+  // A client whose node answers AccountByName with `answer()`, recording the priority of each call.
+  const stubClient = (answer) => {
+    let client = {fetches: [], chain: () => null, metricsRegistry: {count: () => null}};
+    client.api = () => ({DB: {AccountByName: (account, {priority}) => {
+      client.fetches.push(priority);
+      return answer();
+    }}});
+    return client;
+  };
+
+  const cacheOf = (acc) => {
+    let cache = new AuthorityCache();
+    cache.set(acc);
+    return cache;
+  };
+
+  it('should verify a cached login without asking the node', async () => {
+    let client = stubClient(() => Promise.resolve(account()));
+    let res = await Account.login(name, password, {client, cached: true, authorities: cacheOf(account())});
+    assert(res.memoKey && client.fetches.join() === String(Priority.BACKGROUND));
+    assert(await res.revalidated === true);
+  });
+
+  it('should fetch the account when the password does not match the record', async () => {
+    let client = stubClient(() => Promise.resolve(account()));
+    let error = await Account.login(name, "wrong", {client, cached: true, authorities: cacheOf(account())})
+      .then(() => null, e => e);
+    assert(error && /do not match/.test(error.message));
+    assert(client.fetches.join() === String(Priority.INTERACTIVE));
+  });
+
+  it('should report rotated owner, active and memo keys and replace the record', async () => {
+    for (let role of ["owner", "active", "memo"]) {
+      let rotated = account({[role]: pub(role, "rotated")});
+      let cache = cacheOf(account());
+      let previous = cache.get(name);
+      let rotations = [];
+      let onKeyRotation = (who, before, after) => rotations.push([who, before, after]);
+      let res = await Account.login(name, password, {
+        client: stubClient(() => Promise.resolve(rotated)), cached: true, authorities: cache, onKeyRotation,
+      });
+      assert(await res.revalidated === false && rotations.length === 1);
+      let [rotatedName, before, after] = rotations[0];
+      assert(rotatedName === name && before === previous && after === cache.get(name) && after !== previous);
+      assert(cache.keys.toString(role === "memo" ? after.memo : after.key(role)) === pub(role, "rotated"));
+    }
+  });
+
+  it('should resolve revalidation to null when the node cannot be asked', async () => {
+    let rotations = 0;
+    let cache = cacheOf(account());
+    let previous = cache.get(name);
+    let res = await Account.login(name, password, {
+      client: stubClient(() => Promise.reject(new Error("down"))), cached: true, authorities: cache,
+      onKeyRotation: () => rotations++,
+    });
+    assert(await res.revalidated === null && rotations === 0 && cache.get(name) === previous);
+  });
+});
+
 describe('Test Get Account By Name', () => {
   it('should test get account by name', () => {
     BitShares.connect("wss://bitshares.openledger.info/ws").then(() => {